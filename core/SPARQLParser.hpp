@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -192,6 +193,16 @@ public:
         /// Desending
         bool descending;
     };
+    /// Aggregate function
+    enum AggregateType { Agg_Count, Agg_Sum, Agg_Min, Agg_Max, Agg_Avg };
+    /// Aggregate in projection, e.g., (COUNT(?x) AS ?n)
+    struct Aggregate {
+        AggregateType type;
+        /// Variable id, 0 means all rows (i.e. COUNT(*))
+        int id;
+        /// Variable id of the result
+        int alias;
+    };
 
 private:
     /// The lexer
@@ -209,6 +220,10 @@ private:
     ProjectionModifier projectionModifier;
     /// The projection clause
     std::vector<int> projection;
+    /// The aggregates in projection
+    std::vector<Aggregate> aggregates;
+    /// The group by clause
+    std::vector<int> groupBy;
     /// The pattern
     PatternGroup patterns;
     /// The sort order
@@ -981,6 +996,8 @@ private:
             SPARQLLexer::Token token = lexer.getNext();
             if (token == SPARQLLexer::Variable) {
                 projection.push_back(nameVariable(lexer.getTokenValue()));
+            } else if (token == SPARQLLexer::LParen) {
+                parseAggregate();
             } else if (token == SPARQLLexer::Mul) {
                 // We do nothing here. Empty projections will be filled with all
                 // named variables after parsing
@@ -993,6 +1010,41 @@ private:
             first = false;
         }
     }
+    /// Parse an aggregate in projection, i.e., AGG(?var) AS ?alias) or COUNT(*) AS ?alias)
+    void parseAggregate() {
+        Aggregate agg;
+        if (lexer.getNext() != SPARQLLexer::Identifier)
+            throw ParserException("aggregate function expected");
+        if (lexer.isKeyword("count")) agg.type = Agg_Count;
+        else if (lexer.isKeyword("sum")) agg.type = Agg_Sum;
+        else if (lexer.isKeyword("min")) agg.type = Agg_Min;
+        else if (lexer.isKeyword("max")) agg.type = Agg_Max;
+        else if (lexer.isKeyword("avg")) agg.type = Agg_Avg;
+        else throw ParserException("unsupported aggregate function");
+
+        if (lexer.getNext() != SPARQLLexer::LParen)
+            throw ParserException("'(' expected");
+        SPARQLLexer::Token token = lexer.getNext();
+        if (token == SPARQLLexer::Variable)
+            agg.id = nameVariable(lexer.getTokenValue());
+        else if ((token == SPARQLLexer::Mul) && (agg.type == Agg_Count))
+            agg.id = 0;
+        else
+            throw ParserException("variable expected in aggregate function");
+        if (lexer.getNext() != SPARQLLexer::RParen)
+            throw ParserException("')' expected");
+
+        if ((lexer.getNext() != SPARQLLexer::Identifier) || (!lexer.isKeyword("as")))
+            throw ParserException("'as' expected");
+        if (lexer.getNext() != SPARQLLexer::Variable)
+            throw ParserException("variable expected after 'as'");
+        agg.alias = nameVariable(lexer.getTokenValue());
+        if (lexer.getNext() != SPARQLLexer::RParen)
+            throw ParserException("')' expected");
+
+        aggregates.push_back(agg);
+        projection.push_back(agg.alias);
+    }
     /// Parse the from part if any
     void parseFrom() {
         while (true) {
@@ -1016,6 +1068,30 @@ private:
         patterns = PatternGroup();
         parseGroupGraphPattern(patterns);
     }
+    /// Parse the group by part if any
+    void parseGroupBy() {
+        SPARQLLexer::Token token = lexer.getNext();
+        if ((token != SPARQLLexer::Identifier) || (!lexer.isKeyword("group"))) {
+            lexer.unget(token);
+            return;
+        }
+        if ((lexer.getNext() != SPARQLLexer::Identifier) || (!lexer.isKeyword("by")))
+            throw ParserException("'by' expected");
+
+        while (true) {
+            token = lexer.getNext();
+            if (token == SPARQLLexer::Variable) {
+                int var = nameVariable(lexer.getTokenValue());
+                if (find(groupBy.begin(), groupBy.end(), var) == groupBy.end())
+                    groupBy.push_back(var);
+            } else {
+                if (groupBy.empty())
+                    throw ParserException("variable expected in group-by clause");
+                lexer.unget(token);
+                return;
+            }
+        }
+    }
     /// Parse the order by part if any
     void parseOrderBy() {
         SPARQLLexer::Token token = lexer.getNext();
@@ -1122,6 +1198,9 @@ public:
         // Parse the where clause
         parseWhere();
 
+        // Parse the group by clause
+        parseGroupBy();
+
         // Parse the order by clause
         parseOrderBy();
 
@@ -1141,6 +1220,17 @@ public:
                     iter != limit; ++iter)
                 projection.push_back((*iter).second);
         }
+
+        // Check that only grouped variables and aggregates are projected
+        if (aggregates.size() || groupBy.size()) {
+            for (int var : projection) {
+                bool valid = (find(groupBy.begin(), groupBy.end(), var) != groupBy.end());
+                for (const Aggregate &agg : aggregates)
+                    if (agg.alias == var) valid = true;
+                if (!valid)
+                    throw ParserException("projection of ungrouped variable " + getVariableName(var));
+            }
+        }
     }
 
     /// Get the patterns
@@ -1168,6 +1258,20 @@ public:
     /// Iterator over the order by clause
     order_iterator orderEnd() const { return order.end(); }
 
+    /// Iterator over the aggregates
+    typedef std::vector<Aggregate>::const_iterator aggregate_iterator;
+    /// Iterator over the aggregates
+    aggregate_iterator aggregateBegin() const { return aggregates.begin(); }
+    /// Iterator over the aggregates
+    aggregate_iterator aggregateEnd() const { return aggregates.end(); }
+
+    /// Iterator over the group by clause
+    typedef std::vector<int>::const_iterator group_iterator;
+    /// Iterator over the group by clause
+    group_iterator groupBegin() const { return groupBy.begin(); }
+    /// Iterator over the group by clause
+    group_iterator groupEnd() const { return groupBy.end(); }
+
     /// The projection modifier
     ProjectionModifier getProjectionModifier() const { return projectionModifier; }
     /// The size limit
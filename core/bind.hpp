@@ -164,6 +164,16 @@ bool load_core_binding(string fname)
 }
 
 
+/*
+ * Return the core of given thread (user-defined binding first)
+ */
+int core_of_thread(int tid)
+{
+    if (enable_binding && core_bindings.count(tid) != 0)
+        return core_bindings[tid];
+    return default_bindings[tid % num_cores];
+}
+
 /*
  * Bind the current thread to a special core (core number)
  */
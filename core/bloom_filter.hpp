@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h> // uint64_t
+#include <vector>
+
+#include "mymath.hpp"
+
+using namespace std;
+
+/**
+ * A (register-)blocked Bloom filter over the hashes of keys.
+ *
+ * All NBITS bits of a key are set in the same 64-bit word, so that a lookup
+ * costs a single cache miss. The filter never returns false negatives, and
+ * an empty (not built) filter conservatively contains everything.
+ */
+class Bloom_Filter {
+private:
+    static const int NBITS = 4; // #bits set per key
+
+    vector<uint64_t> words;
+    uint64_t mask = 0;
+
+    // the word is selected by the low bits and the bits in it by the high bits
+    static inline uint64_t bits_of(uint64_t h) {
+        uint64_t m = 0;
+        for (int i = 0; i < NBITS; i++)
+            m |= 1ull << ((h >> (64 - 6 * (i + 1))) & 63);
+        return m;
+    }
+
+public:
+    // Create an empty filter for about @nkeys keys with @bits_per_key bits each.
+    void init(uint64_t nkeys, int bits_per_key) {
+        uint64_t nwords = 1;
+        while (nwords * 64 < nkeys * bits_per_key)
+            nwords <<= 1;
+
+        words.assign(nwords, 0);
+        mask = nwords - 1;
+    }
+
+    void clear() { words.clear(); mask = 0; }
+
+    bool empty() const { return words.empty(); }
+
+    uint64_t size() const { return words.size() * sizeof(uint64_t); } // in bytes
+
+    // thread-safe, and no-op if the filter is not built
+    void insert(uint64_t hash) {
+        if (words.empty())
+            return;
+
+        uint64_t h = mymath::hash_u64(hash);
+        __sync_fetch_and_or(&words[h & mask], bits_of(h));
+    }
+
+    bool may_contain(uint64_t hash) const {
+        if (words.empty())
+            return true;
+
+        uint64_t h = mymath::hash_u64(hash);
+        uint64_t m = bits_of(h);
+        return (words[h & mask] & m) == m;
+    }
+
+    // the raw words are used to replicate the filter to other servers
+    vector<uint64_t> &raw() { return words; }
+
+    void load(const uint64_t *data, uint64_t nwords) {
+        words.assign(data, data + nwords);
+        mask = nwords ? nwords - 1 : 0;
+    }
+};
@@ -44,6 +44,7 @@ int global_num_proxies = 1;    // the number of proxies
 int global_num_engines = 1;    // the number of engines
 
 string global_input_folder;
+string global_snapshot_folder;  // empty means snapshot is disabled
 
 int global_data_port_base = 5500;
 int global_ctrl_port_base = 9576;
@@ -51,16 +52,24 @@ int global_ctrl_port_base = 9576;
 int global_memstore_size_gb = 20;
 int global_rdma_buf_size_mb = 64;
 int global_rdma_rbf_size_mb = 16;
+int global_rdma_cache_entries = 100000;
+int global_key_filter_bits = 8;  // bits per key of Bloom filters over keys (0: disabled)
+
+int global_hugepage_size_mb = 0;      // 0: regular pages, 2: 2MB huge pages, 1024: 1GB huge pages
+bool global_numa_interleave = false;  // interleave memory across NUMA nodes (first-touch otherwise)
 
 bool global_use_rdma = true;
 bool global_generate_statistics = true;
 bool global_enable_caching = true;
 bool global_enable_workstealing = false;
+bool global_enable_adaptive_forkjoin = true;  // cost-based fork-join (or global_rdma_threshold)
 
 int global_mt_threshold = 16;
 int global_rdma_threshold = 300;
+int global_morsel_size = 8192;  // #rows per morsel for intra-query parallelism (0: disabled)
 
 bool global_silent = true;  // don't take back results by default
+int global_stream_rows = 65536;  // #rows per chunk of streamed results (0: disabled)
 
 bool global_enable_planner = true;  // for planner
 
@@ -87,6 +96,13 @@ static bool set_immutable_config(string cfg_name, string value)
         // force a "/" at the end of global_input_folder.
         if (global_input_folder[global_input_folder.length() - 1] != '/')
             global_input_folder = global_input_folder + "/";
+    } else if (cfg_name == "global_snapshot_folder") {
+        global_snapshot_folder = value;
+
+        // force a "/" at the end of global_snapshot_folder.
+        if (global_snapshot_folder.length() > 0
+                && global_snapshot_folder[global_snapshot_folder.length() - 1] != '/')
+            global_snapshot_folder = global_snapshot_folder + "/";
     } else if (cfg_name == "global_data_port_base") {
         global_data_port_base = atoi(value.c_str());
         ASSERT(global_data_port_base > 0);
@@ -102,6 +118,19 @@ static bool set_immutable_config(string cfg_name, string value)
     } else if (cfg_name == "global_rdma_rbf_size_mb") {
         global_rdma_rbf_size_mb = atoi(value.c_str());
         ASSERT(global_rdma_rbf_size_mb > 0);
+    } else if (cfg_name == "global_rdma_cache_entries") {
+        global_rdma_cache_entries = atoi(value.c_str());
+        ASSERT(global_rdma_cache_entries > 0);
+    } else if (cfg_name == "global_key_filter_bits") {
+        global_key_filter_bits = atoi(value.c_str());
+        ASSERT(global_key_filter_bits >= 0);
+    } else if (cfg_name == "global_hugepage_size_mb") {
+        global_hugepage_size_mb = atoi(value.c_str());
+        ASSERT(global_hugepage_size_mb == 0
+               || global_hugepage_size_mb == 2
+               || global_hugepage_size_mb == 1024);
+    } else if (cfg_name == "global_numa_interleave") {
+        global_numa_interleave = atoi(value.c_str());
     } else if (cfg_name == "global_generate_statistics") {
         global_generate_statistics = atoi(value.c_str());
     }
@@ -129,6 +158,9 @@ static bool set_mutable_config(string cfg_name, string value)
         }
     } else if (cfg_name == "global_rdma_threshold") {
         global_rdma_threshold = atoi(value.c_str());
+    } else if (cfg_name == "global_morsel_size") {
+        global_morsel_size = atoi(value.c_str());
+        ASSERT(global_morsel_size >= 0);
     } else if (cfg_name == "global_mt_threshold") {
         global_mt_threshold = atoi(value.c_str());
         ASSERT(global_mt_threshold > 0);
@@ -136,8 +168,13 @@ static bool set_mutable_config(string cfg_name, string value)
         global_enable_caching = atoi(value.c_str());
     } else if (cfg_name == "global_enable_workstealing") {
         global_enable_workstealing = atoi(value.c_str());
+    } else if (cfg_name == "global_enable_adaptive_forkjoin") {
+        global_enable_adaptive_forkjoin = atoi(value.c_str());
     } else if (cfg_name == "global_silent") {
         global_silent = atoi(value.c_str());
+    } else if (cfg_name == "global_stream_rows") {
+        global_stream_rows = atoi(value.c_str());
+        ASSERT(global_stream_rows >= 0);
     } else if (cfg_name == "global_enable_planner") {
         global_enable_planner = atoi(value.c_str());
     } else if (cfg_name == "global_enable_vattr") {
@@ -236,17 +273,25 @@ void print_config(void)
     logstream(LOG_INFO) << "the number of proxies: "        << global_num_proxies           << LOG_endl;
     logstream(LOG_INFO) << "the number of engines: "        << global_num_engines           << LOG_endl;
     logstream(LOG_INFO) << "global_input_folder: "      << global_input_folder          << LOG_endl;
+    logstream(LOG_INFO) << "global_snapshot_folder: "   << global_snapshot_folder       << LOG_endl;
     logstream(LOG_INFO) << "global_data_port_base: "        << global_data_port_base        << LOG_endl;
     logstream(LOG_INFO) << "global_ctrl_port_base: "        << global_ctrl_port_base        << LOG_endl;
     logstream(LOG_INFO) << "global_memstore_size_gb: "  << global_memstore_size_gb      << LOG_endl;
     logstream(LOG_INFO) << "global_rdma_buf_size_mb: "  << global_rdma_buf_size_mb      << LOG_endl;
     logstream(LOG_INFO) << "global_rdma_rbf_size_mb: "  << global_rdma_rbf_size_mb      << LOG_endl;
+    logstream(LOG_INFO) << "global_rdma_cache_entries: "    << global_rdma_cache_entries    << LOG_endl;
+    logstream(LOG_INFO) << "global_key_filter_bits: "   << global_key_filter_bits       << LOG_endl;
+    logstream(LOG_INFO) << "global_hugepage_size_mb: "  << global_hugepage_size_mb      << LOG_endl;
+    logstream(LOG_INFO) << "global_numa_interleave: "   << global_numa_interleave       << LOG_endl;
     logstream(LOG_INFO) << "global_use_rdma: "          << global_use_rdma              << LOG_endl;
     logstream(LOG_INFO) << "global_enable_caching: "        << global_enable_caching        << LOG_endl;
     logstream(LOG_INFO) << "global_enable_workstealing: "   << global_enable_workstealing   << LOG_endl;
+    logstream(LOG_INFO) << "global_enable_adaptive_forkjoin: " << global_enable_adaptive_forkjoin << LOG_endl;
     logstream(LOG_INFO) << "global_rdma_threshold: "        << global_rdma_threshold        << LOG_endl;
     logstream(LOG_INFO) << "global_mt_threshold: "      << global_mt_threshold          << LOG_endl;
+    logstream(LOG_INFO) << "global_morsel_size: "       << global_morsel_size           << LOG_endl;
     logstream(LOG_INFO) << "global_silent: "                << global_silent                << LOG_endl;
+    logstream(LOG_INFO) << "global_stream_rows: "       << global_stream_rows           << LOG_endl;
     logstream(LOG_INFO) << "global_enable_planner: "        << global_enable_planner        << LOG_endl;
     logstream(LOG_INFO) << "global_generate_statistics: "   << global_generate_statistics   << LOG_endl;
     logstream(LOG_INFO) << "global_enable_vattr: "      << global_enable_vattr          << LOG_endl;
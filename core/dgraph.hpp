@@ -506,13 +506,82 @@ class DGraph {
         return original - original % n + n;
     }
 
+    string dataset;        // the directory of input data
+    bool from_snapshot;    // whether gstore is restored from the snapshot
+    string snapshot_stat;  // (serialized) statistics restored from the snapshot
+
+    string snapshot_fname() {
+        return global_snapshot_folder + "gstore_" + to_string(sid) + ".snapshot";
+    }
+
+    // Restore gstore from the snapshot (if any) instead of loading and building it.
+    bool load_snapshot() {
+        if (global_snapshot_folder.empty())
+            return false;
+
+        uint64_t start = timer::get_usec();
+        int ok = gstore.load_snapshot(snapshot_fname(), dataset, snapshot_stat);
+
+        // all servers should use their snapshots, otherwise all of them reload data
+        int all_ok = 0;
+        MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (!all_ok) {
+            snapshot_stat.clear();
+            return false;
+        }
+
+        uint64_t end = timer::get_usec();
+        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << " ms "
+                            << "for restoring gstore from snapshot " << snapshot_fname() << LOG_endl;
+        return true;
+    }
+
+    // Replicate the Bloom filter over local keys to all servers.
+    void sync_key_filters() {
+        if (global_key_filter_bits == 0)
+            return;
+
+        uint64_t start = timer::get_usec();
+        vector<uint64_t> &local = gstore.get_key_filter(sid).raw();
+        int nwords = local.size();
+        vector<int> counts(global_num_servers), displs(global_num_servers);
+        MPI_Allgather(&nwords, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+        uint64_t total = 0;
+        for (int s = 0; s < global_num_servers; s++) {
+            displs[s] = total;
+            total += counts[s];
+        }
+
+        vector<uint64_t> all(total);
+        MPI_Allgatherv(local.data(), nwords, MPI_UINT64_T,
+                       all.data(), counts.data(), displs.data(), MPI_UINT64_T, MPI_COMM_WORLD);
+        for (int s = 0; s < global_num_servers; s++)
+            if (s != sid)
+                gstore.get_key_filter(s).load(&all[displs[s]], counts[s]);
+        gstore.set_key_filters_synced(true);
+
+        uint64_t end = timer::get_usec();
+        logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
+                            << "for synchronizing key filters" << LOG_endl;
+    }
+
 public:
     GStore gstore;
 
     DGraph(int sid, Mem *mem, String_Server *str_server, string dname)
-        : sid(sid), str_server(str_server), mem(mem), gstore(sid, mem) {
+        : sid(sid), mem(mem), str_server(str_server),
+          dataset(dname), from_snapshot(false), gstore(sid, mem) {
         uint64_t start, end;
 
+        if (load_snapshot()) {
+            from_snapshot = true;
+            sync_key_filters();
+            logstream(LOG_INFO) << "#" << sid << ": loading DGraph is finished" << LOG_endl;
+            gstore.print_mem_usage();
+            return;
+        }
+
         num_triples.resize(global_num_servers);
 
         triple_spo.resize(global_num_engines);
@@ -602,13 +671,53 @@ public:
         logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << "ms "
                             << "for inserting index data into gstore" << LOG_endl;
 
+        sync_key_filters();
+
         logstream(LOG_INFO) << "#" << sid << ": loading DGraph is finished" << LOG_endl;
         gstore.print_mem_usage();
+        if (global_logger().get_log_level() <= LOG_DEBUG)
+            gstore.print_probe_latency();
+    }
+
+    // Restore the (local) statistics from the snapshot.
+    bool load_snapshot_stat(data_statistic &stat) {
+        if (snapshot_stat.empty())
+            return false;
+
+        std::stringstream ss(snapshot_stat);
+        boost::archive::binary_iarchive ia(ss);
+        ia >> stat;
+        return true;
+    }
+
+    // Store the snapshot of gstore (w/ the local statistics) for fast restart.
+    // @stat: NULL if no statistics is generated
+    void store_snapshot(data_statistic *stat) {
+        if (global_snapshot_folder.empty() || from_snapshot)
+            return;
+
+        uint64_t start = timer::get_usec();
+        string ss_stat;
+        if (stat != NULL) {
+            std::stringstream ss;
+            boost::archive::binary_oarchive oa(ss);
+            oa << (*stat);
+            ss_stat = ss.str();
+        }
+
+        if (gstore.store_snapshot(snapshot_fname(), dataset, ss_stat)) {
+            uint64_t end = timer::get_usec();
+            logstream(LOG_INFO) << "#" << sid << ": " << (end - start) / 1000 << " ms "
+                                << "for storing gstore to snapshot " << snapshot_fname() << LOG_endl;
+        }
     }
 
 
 #ifdef DYNAMIC_GSTORE
     int64_t dynamic_load_data(string dname, bool check_dup) {
+        // the replicas of key filters will be stale since all servers insert new keys
+        gstore.set_key_filters_synced(false);
+
         dynamic_load_mappings(dname); // load ID-mapping files and construct id2id mapping
 
         vector<string> dfiles(list_files(dname, "id_"));   // ID-format data files
@@ -723,6 +832,17 @@ public:
         return gstore.get_edges_global(tid, vid, d, pid, sz);
     }
 
+    // the statistics of RDMA cache (of given thread)
+    void get_cache_stats(int tid, uint64_t &hits, uint64_t &misses) {
+        gstore.get_cache_stats(tid, hits, misses);
+    }
+
+    // batched get_edges_global (see GStore::get_edges_batch)
+    uint64_t get_edges_batch(int tid, const vector<ikey_t> &keys, uint64_t first,
+                             vector<edge_span_t> &spans) {
+        return gstore.get_edges_batch(tid, keys, first, spans);
+    }
+
     // FIXME: rename the function by the term of RDF model (e.g., subject/object)
     edge_t *get_index_edges_local(int tid, sid_t vid, dir_t d, uint64_t *sz) {
         return gstore.get_index_edges_local(tid, vid, d, sz);
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h> // uint64_t
+#include <string.h> // memcpy, memset
+#include <vector>
+
+#include "type.hpp"
+#include "assertion.hpp"
+
+using namespace std;
+
+/**
+ * Compression of the sorted values (edges) of a key in the entry region.
+ *
+ * The values are split into blocks of BLOCK values (frame of reference). Each block
+ * keeps its first value and the bit width of the largest delta between neighboring
+ * values, followed by the deltas bit-packed in (width * (#values - 1)) bits.
+ *
+ * Layout (in sid_t words), distinguished by the stored size (#words):
+ *   size <= RAW_MAX:  | raw values |
+ *   size == #values + 1:  | #values | raw values |  (the compression does not pay off)
+ *   otherwise:  | #values | block | block | ... |, block = | first | width | deltas |
+ *
+ * NOTE: the stored size is always known by the reader (i.e., iptr_t.size), so that
+ *       a remote list can be fetched in a single RDMA read.
+ */
+class EdgeCodec {
+private:
+    static const int WBITS = sizeof(sid_t) * 8;
+
+    static inline int width_of(uint64_t delta) {
+        return delta ? 64 - __builtin_clzll(delta) : 0;
+    }
+
+    static inline uint64_t words_of(uint64_t cnt, int width) {
+        return 2 + ((cnt - 1) * width + WBITS - 1) / WBITS;
+    }
+
+    // the output should be cleared in advance
+    static inline void put_bits(sid_t *out, uint64_t pos, uint64_t v, int width) {
+        uint64_t idx = pos / WBITS, sh = pos % WBITS;
+        out[idx] |= (sid_t)(v << sh);
+        if (sh + width > WBITS)
+            out[idx + 1] |= (sid_t)(v >> (WBITS - sh));
+    }
+
+    static inline uint64_t get_bits(const sid_t *in, uint64_t pos, int width) {
+        uint64_t idx = pos / WBITS, sh = pos % WBITS;
+        uint64_t v = (uint64_t)in[idx] >> sh;
+        if (sh + width > WBITS)
+            v |= (uint64_t)in[idx + 1] << (WBITS - sh);
+        return (width == 64) ? v : (v & ((1ull << width) - 1));
+    }
+
+    static uint64_t compressed_size(const sid_t *vals, uint64_t n) {
+        uint64_t sz = 1; // #values
+        for (uint64_t b = 0; b < n; b += BLOCK) {
+            uint64_t cnt = (n - b < BLOCK) ? (n - b) : BLOCK;
+            int width = 0;
+            for (uint64_t i = b + 1; i < b + cnt; i++)
+                width = max(width, width_of(vals[i] - vals[i - 1]));
+            sz += words_of(cnt, width);
+        }
+        return sz;
+    }
+
+public:
+    static const uint64_t RAW_MAX = 16; // short lists are always stored raw
+    static const uint64_t BLOCK = 128;
+
+    // Return the stored size (#words) of given sorted values.
+    static uint64_t encoded_size(const sid_t *vals, uint64_t n) {
+        if (n <= RAW_MAX)
+            return n;
+
+        // a compressed list should be longer than a short one
+        uint64_t sz = max(compressed_size(vals, n), RAW_MAX + 1);
+        return min(sz, n + 1);
+    }
+
+    // Encode given sorted values to @out, whose size (@sz) is from encoded_size().
+    static void encode(const sid_t *vals, uint64_t n, sid_t *out, uint64_t sz) {
+        if (n <= RAW_MAX) {
+            memcpy(out, vals, n * sizeof(sid_t));
+            return;
+        }
+
+        out[0] = n;
+        if (sz == n + 1) {
+            memcpy(out + 1, vals, n * sizeof(sid_t));
+            return;
+        }
+
+        memset(out + 1, 0, (sz - 1) * sizeof(sid_t));
+        uint64_t w = 1;
+        for (uint64_t b = 0; b < n; b += BLOCK) {
+            uint64_t cnt = (n - b < BLOCK) ? (n - b) : BLOCK;
+            int width = 0;
+            for (uint64_t i = b + 1; i < b + cnt; i++) {
+                ASSERT(vals[i] >= vals[i - 1]); // should be sorted
+                width = max(width, width_of(vals[i] - vals[i - 1]));
+            }
+
+            out[w] = vals[b];
+            out[w + 1] = width;
+            for (uint64_t i = 1; i < cnt; i++)
+                put_bits(out + w + 2, (i - 1) * width, vals[b + i] - vals[b + i - 1], width);
+            w += words_of(cnt, width);
+        }
+        ASSERT(w <= sz);
+    }
+
+    // Return the number of values stored in @in of given stored size (@sz).
+    static inline uint64_t count(const sid_t *in, uint64_t sz) {
+        return (sz <= RAW_MAX) ? sz : in[0];
+    }
+
+    // Decode the values stored in @in of given stored size (@sz).
+    // Raw values are returned in place, otherwise they are decoded to @buf.
+    static const sid_t *decode(const sid_t *in, uint64_t sz, uint64_t *n, vector<sid_t> &buf) {
+        *n = count(in, sz);
+        if (sz <= RAW_MAX)
+            return in;
+        if (sz == *n + 1)
+            return in + 1;
+
+        if (buf.size() < *n)
+            buf.resize(*n);
+
+        sid_t *out = buf.data();
+        uint64_t w = 1;
+        for (uint64_t b = 0; b < *n; b += BLOCK) {
+            uint64_t cnt = (*n - b < BLOCK) ? (*n - b) : BLOCK;
+            int width = in[w + 1];
+            const sid_t *deltas = in + w + 2;
+
+            sid_t v = in[w];
+            out[b] = v;
+            if (width == 0) {
+                for (uint64_t i = 1; i < cnt; i++)
+                    out[b + i] = v;
+            } else {
+                for (uint64_t i = 1; i < cnt; i++) {
+                    v += get_bits(deltas, (i - 1) * width, width);
+                    out[b + i] = v;
+                }
+            }
+            w += words_of(cnt, width);
+        }
+        return out;
+    }
+};
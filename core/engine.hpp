@@ -25,6 +25,9 @@
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
 #include <algorithm>//sort
+#include <deque>
+#include <atomic>
+#include <functional>
 #include <regex>
 
 #include "config.hpp"
@@ -33,6 +36,7 @@
 #include "adaptor.hpp"
 #include "dgraph.hpp"
 #include "query.hpp"
+#include "radix_join.hpp"
 #include "assertion.hpp"
 
 #include "mymath.hpp"
@@ -46,6 +50,41 @@ using namespace std;
 
 #define QUERY_FROM_PROXY(tid) ((tid) < global_num_proxies)
 
+// The fetcher is used to get the edges of a sequence of keys in batches (see GStore::get_edges_batch)
+// The keys are added first, and then their edges should be got in order.
+class Batch_Fetcher {
+private:
+    DGraph *graph;
+    int tid;
+
+    vector<ikey_t> keys;
+    vector<edge_span_t> spans; // the edges of keys[first, first + spans.size())
+    uint64_t first = 0;
+
+public:
+    Batch_Fetcher(DGraph *graph, int tid) : graph(graph), tid(tid) { }
+
+    // Add a key and return its index. The same consecutive keys are deduplicated.
+    uint64_t add(sid_t vid, dir_t d, sid_t pid) {
+        ikey_t key(vid, pid, d);
+        if (keys.empty() || keys.back() != key)
+            keys.push_back(key);
+        return keys.size() - 1;
+    }
+
+    edge_t *get(uint64_t idx, uint64_t *sz) {
+        ASSERT(idx >= first);
+        while (idx >= first + spans.size()) {
+            first += spans.size();
+            spans.clear();
+            graph->get_edges_batch(tid, keys, first, spans);
+        }
+
+        *sz = spans[idx - first].sz;
+        return spans[idx - first].ptr;
+    }
+};
+
 // The map is used to colloect the replies of sub-queries in fork-join execution
 class Reply_Map {
 private:
@@ -54,12 +93,25 @@ private:
         int cnt; // #sub-queries
         SPARQLQuery parent;
         SPARQLQuery reply;
+
+        uint64_t start_time; // of fork
+        uint64_t fork_rows;  // max #rows sent to a server by the fork-join of a pattern
     };
 
     boost::unordered_map<int, Item> internal_map;
+    boost::unordered_map<int, int> cancelled; // pid -> #replies to discard
+
+    // the replies are enough if all patterns are done and the rows satisfy LIMIT
+    bool is_enough(Item &d) {
+        int64_t need = d.parent.enough_rows();
+        return (need >= 0
+                && d.parent.state == SPARQLQuery::SQState::SQ_PATTERN
+                && d.reply.pattern_step >= d.parent.pattern_group.patterns.size()
+                && d.reply.result.row_num >= need);
+    }
 
 public:
-    void put_parent_request(SPARQLQuery &r, int cnt) {
+    void put_parent_request(SPARQLQuery &r, int cnt, uint64_t fork_rows = 0) {
         logstream(LOG_DEBUG) << "add pid=" << r.id << " and cnt=" << cnt << LOG_endl;
 
         // not exist
@@ -68,11 +120,20 @@ public:
         Item d;
         d.cnt = cnt;
         d.parent = r;
+        d.start_time = timer::get_usec();
+        d.fork_rows = fork_rows;
 
         internal_map[r.id] = d;
     }
 
-    void put_reply(SPARQLQuery &r) {
+    // Return false if the reply is discarded (the parent has been cancelled).
+    bool put_reply(SPARQLQuery &r) {
+        if (cancelled.find(r.pid) != cancelled.end()) {
+            if (--cancelled[r.pid] == 0)
+                cancelled.erase(r.pid);
+            return false;
+        }
+
         // exist
         ASSERT(internal_map.find(r.pid) != internal_map.end());
 
@@ -89,10 +150,23 @@ public:
         // keep inprogress
         if (d.parent.state == SPARQLQuery::SQState::SQ_PATTERN)
             d.reply.pattern_step = r.pattern_step;
+        return true;
     }
 
+    // ready if all sub-queries have done, or the replies are enough for LIMIT
+    // (the rest of sub-queries are cancelled by get_merged_reply)
     bool is_ready(int pid) {
-        return internal_map[pid].cnt == 0;
+        Item &d = internal_map[pid];
+        return (d.cnt == 0 || is_enough(d));
+    }
+
+    // Get the max #rows sent to a server and the elapsed time of the fork-join of a pattern.
+    // Return false for other kinds of sub-queries (e.g., UNION).
+    bool get_fork_stat(int pid, uint64_t &rows, uint64_t &us) {
+        Item &d = internal_map[pid];
+        rows = d.fork_rows;
+        us = timer::get_usec() - d.start_time;
+        return (d.fork_rows > 0);
     }
 
     SPARQLQuery get_merged_reply(int pid) {
@@ -103,6 +177,7 @@ public:
         // FIXME: implement copy construct of SPARQLQuery::Result
         r.result.col_num = reply.result.col_num;
         r.result.blind = reply.result.blind;
+        r.result.aggregated = reply.result.aggregated;
         r.result.row_num = reply.result.row_num;
         r.result.attr_col_num = reply.result.attr_col_num;
         r.result.v2c_map = reply.result.v2c_map;
@@ -113,6 +188,13 @@ public:
         if (r.state == SPARQLQuery::SQState::SQ_PATTERN)
             r.pattern_step = reply.pattern_step;
 
+        // discard the replies of the rest of sub-queries
+        if (internal_map[pid].cnt > 0) {
+            logstream(LOG_DEBUG) << "cancel pid=" << pid
+                                 << " and cnt=" << internal_map[pid].cnt << LOG_endl;
+            cancelled[pid] = internal_map[pid].cnt;
+        }
+
         internal_map.erase(pid);
         logstream(LOG_DEBUG) << "erase pid=" << pid << LOG_endl;
         return r;
@@ -120,19 +202,265 @@ public:
 };
 
 
-typedef pair<int64_t, int64_t> int64_pair;
+// The cost model to choose fork-join or in-place execution for a pattern (see Engine::need_fork_join).
+//   in-place:  #distinct remote vertices * miss ratio of RDMA cache * read latency + #rows * row cost
+//   fork-join: a round trip of messages + max #rows sent to a server * row cost (in parallel)
+// The distinct vertices and the rows of servers are estimated by a sample of rows,
+// and the costs are calibrated online by the measured patterns and fork-joins (EWMA).
+class Fork_Join_Model {
+private:
+    static const uint64_t SAMPLE_ROWS = 4096;
+    static constexpr double ALPHA = 0.1; // the weight of a new measurement
+
+    double read_us = 5.0;    // per remote lookup (missed in RDMA cache)
+    double row_us = 0.2;     // per row of a pattern executed locally
+    double msg_us = 200.0;   // per fork-join (excl. the execution of sub-queries)
+    double hit_ratio = 0.0;  // of RDMA cache
+    uint64_t hits = 0, misses = 0; // last counters of RDMA cache
+
+    static inline void ewma(double &v, double sample) { v = (1 - ALPHA) * v + ALPHA * sample; }
+
+public:
+    struct estimate_t {
+        bool valid = false;
+        uint64_t rows = 0;
+        double lookups = 0;        // remote lookups (missed in RDMA cache)
+        uint64_t max_dst_rows = 0; // max #rows sent to a server by fork-join
+        double in_place_us = 0;
+        double fork_us = 0;
+    };
+
+    // the counters of RDMA cache (of the engine)
+    void update_cache_stats(uint64_t h, uint64_t m) {
+        if ((h - hits) + (m - misses) >= SAMPLE_ROWS) {
+            ewma(hit_ratio, double(h - hits) / ((h - hits) + (m - misses)));
+            hits = h;
+            misses = m;
+        }
+    }
+
+    estimate_t estimate(SPARQLQuery::Result &res, int col, int sid) {
+        estimate_t est;
+        est.valid = true;
+        est.rows = res.get_row_num();
+
+        uint64_t step = max(est.rows / SAMPLE_ROWS, (uint64_t)1);
+        uint64_t nsamples = 0;
+        vector<uint64_t> dst_rows(global_num_servers, 0);
+        boost::unordered_set<sid_t> remote;
+        for (uint64_t r = 0; r < est.rows; r += step) {
+            sid_t vid = res.get_row_col(r, col);
+            int dst = mymath::hash_mod(vid, global_num_servers);
+            dst_rows[dst]++;
+            if (dst != sid)
+                remote.insert(vid);
+            nsamples++;
+        }
+        double scale = double(est.rows) / max(nsamples, (uint64_t)1);
+
+        est.lookups = remote.size() * scale * (1 - hit_ratio);
+        est.max_dst_rows = *max_element(dst_rows.begin(), dst_rows.end()) * scale;
+        est.in_place_us = est.lookups * read_us + est.rows * row_us;
+        est.fork_us = msg_us + est.max_dst_rows * row_us;
+        return est;
+    }
+
+    void calibrate_in_place(const estimate_t &est, uint64_t us) {
+        if (est.lookups >= 1)
+            ewma(read_us, max((us - est.rows * row_us) / est.lookups, 0.1));
+        else if (est.rows > 0)
+            ewma(row_us, double(us) / est.rows);
+    }
 
-int64_t hash_pair(const int64_pair &x) {
-    int64_t r = x.first;
-    r = r << 32;
-    r += x.second;
-    return hash<int64_t>()(r);
-}
+    // NOTE: the sub-queries must only execute the forked pattern (i.e., the last one), since
+    //       the elapsed time of fork-join includes all the rest of sub-queries (e.g., nested forks)
+    void calibrate_fork(uint64_t max_dst_rows, uint64_t us) {
+        ewma(msg_us, max(us - max_dst_rows * row_us, 1.0));
+    }
+};
 
 // a vector of pointers of all local engines
 class Engine;
 std::vector<Engine *> engines;
 
+// A lock-free multi-producer single-consumer queue (an intrusive linked list),
+// which moves items in and out instead of copying them.
+template <typename T>
+class MPSC_Queue {
+private:
+    struct Node {
+        std::atomic<Node *> next;
+        T item;
+
+        Node() : next(NULL) { }
+        Node(T &&item) : next(NULL), item(std::move(item)) { }
+    };
+
+    std::atomic<Node *> head; // the last pushed node (producers)
+    Node *tail;               // the dummy node before the first item (consumer)
+
+public:
+    MPSC_Queue() {
+        tail = new Node();
+        head.store(tail);
+    }
+
+    ~MPSC_Queue() {
+        T item;
+        while (pop(item)) ;
+        delete tail;
+    }
+
+    // thread-safe
+    void push(T &&item) {
+        Node *node = new Node(std::move(item));
+        Node *prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // only called by the consumer
+    bool pop(T &item) {
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (next == NULL)
+            return false;
+
+        item = std::move(next->item);
+        delete tail;
+        tail = next; // the popped node becomes the dummy one
+        return true;
+    }
+};
+
+// The run queue of an engine, which keeps queries by priority levels, i.e., replies >
+// sub-queries (by depth) > new queries. A waiting query is promoted one level every
+// AGING_TIME, so that new queries are not starved by in-flight ones.
+// NOTE: the engine pops from the front, while other (idle) engines steal from the back.
+class Run_Queue {
+private:
+    static const int NLEVELS = 4;
+    static const uint64_t AGING_TIME = 10000; // 10 msec
+
+    struct Item {
+        uint64_t time; // enqueued
+        SPARQLQuery req;
+    };
+
+    pthread_spinlock_t lock;
+    std::deque<Item> queues[NLEVELS];
+    volatile uint64_t nitems = 0;
+
+    static int level_of(SPARQLQuery &req) {
+        if (req.state == SPARQLQuery::SQState::SQ_REPLY)
+            return NLEVELS - 1;
+        return min(req.priority, NLEVELS - 2);
+    }
+
+public:
+    Run_Queue() { pthread_spin_init(&lock, 0); }
+
+    bool empty() const { return nitems == 0; }
+
+    void push(SPARQLQuery &&req) {
+        int level = level_of(req);
+        Item item{timer::get_usec(), std::move(req)};
+        pthread_spin_lock(&lock);
+        queues[level].push_back(std::move(item));
+        nitems++;
+        pthread_spin_unlock(&lock);
+    }
+
+    // Pop the first query at the highest (aged) level, which is at least @min_level.
+    bool pop(SPARQLQuery &req, int min_level = 0) {
+        if (nitems == 0)
+            return false;
+
+        pthread_spin_lock(&lock);
+        uint64_t now = timer::get_usec();
+        int best = -1;
+        uint64_t best_level = 0;
+        for (int l = NLEVELS - 1; l >= 0; l--) {
+            if (queues[l].empty())
+                continue;
+
+            uint64_t level = l + (now - queues[l].front().time) / AGING_TIME;
+            if (best == -1 || level > best_level) {
+                best = l;
+                best_level = level;
+            }
+        }
+        if (best == -1 || best_level < min_level) {
+            pthread_spin_unlock(&lock);
+            return false;
+        }
+
+        req = std::move(queues[best].front().req);
+        queues[best].pop_front();
+        nitems--;
+        pthread_spin_unlock(&lock);
+        return true;
+    }
+
+    // Steal the last query at the lowest level (i.e., the one to be executed last).
+    // NOTE: replies are never stolen, since they resume the parent queries owned by the engine
+    bool steal(SPARQLQuery &req) {
+        if (nitems == 0)
+            return false;
+
+        bool found = false;
+        pthread_spin_lock(&lock);
+        for (int l = 0; l < NLEVELS - 1 && !found; l++) {
+            if (queues[l].empty())
+                continue;
+
+            req = std::move(queues[l].back().req);
+            queues[l].pop_back();
+            nitems--;
+            found = true;
+        }
+        pthread_spin_unlock(&lock);
+        return found;
+    }
+};
+
+// A morsel is a range of rows of a (heavy) query, whose current pattern can be
+// executed by any engine of the server (see Engine::execute_morsels), or a task
+// of the final process (see Engine::parallel_for)
+struct Morsel {
+    SPARQLQuery req;
+    std::function<void()> task;
+    volatile int *pending; // #morsels of the query not done yet
+};
+
+// The pool of morsels shared by all engines of a server
+class Morsel_Pool {
+private:
+    pthread_spinlock_t lock;
+    std::deque<Morsel *> morsels;
+
+public:
+    Morsel_Pool() { pthread_spin_init(&lock, 0); }
+
+    void push(Morsel *m) {
+        pthread_spin_lock(&lock);
+        morsels.push_back(m);
+        pthread_spin_unlock(&lock);
+    }
+
+    // return NULL if the pool is empty
+    Morsel *pop() {
+        Morsel *m = NULL;
+        pthread_spin_lock(&lock);
+        if (!morsels.empty()) {
+            m = morsels.front();
+            morsels.pop_front();
+        }
+        pthread_spin_unlock(&lock);
+        return m;
+    }
+};
+
+Morsel_Pool morsel_pool;
+
 
 class Engine {
 private:
@@ -146,16 +474,40 @@ private:
             : sid(sid), tid(tid), bundle(bundle) { }
     };
 
-    pthread_spinlock_t recv_lock;
-    std::vector<SPARQLQuery> msg_fast_path;
-    std::vector<SPARQLQuery> runqueue;
+    MPSC_Queue<SPARQLQuery> msg_fast_path;
+    Run_Queue runqueue;
 
     Reply_Map rmap; // a map of replies for pending (fork-join) queries
     pthread_spinlock_t rmap_lock;
 
+    Fork_Join_Model fj_model; // the cost model of fork-join (calibrated online)
+    Fork_Join_Model::estimate_t fj_est; // the last estimate by need_fork_join
+
+    boost::unordered_map<string, regex> regexes; // the compiled regex of FILTER (see get_regex)
+
     vector<Message> pending_msgs;
 
+    // A (large) reply streamed to the proxy in chunks (see stream_reply)
+    struct Stream {
+        int sid;
+        int tid;
+        int chunk_rows;
+        int nrows;
+        vector<sid_t> table;     // all rows of the reply
+        vector<attr_t> attr_table;
+        SPARQLQuery reply;       // the last built chunk (chunk_id)
+        Bundle chunk;
+        bool built = false;      // the chunk is built but not sent
+    };
+    vector<Stream> pending_streams;
+
     inline void sweep_msgs() {
+        for (vector<Stream>::iterator it = pending_streams.begin(); it != pending_streams.end();)
+            if (send_chunks(*it))
+                it = pending_streams.erase(it);
+            else
+                ++it;
+
         if (!pending_msgs.size()) return;
 
         logstream(LOG_INFO) << "#" << tid << " "
@@ -276,16 +628,12 @@ private:
         uint64_t sz = 0;
         edge_t *edges = graph->get_edges_global(tid, start, d, pid, &sz);
 
-        boost::unordered_set<sid_t> unique_set;
-        for (uint64_t k = 0; k < sz; k++)
-            unique_set.insert(edges[k].val);
-
         if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
             int row_num = res.get_row_num();
             ASSERT(row_num == res.optional_matched_rows.size());
             for (uint64_t i = 0; i < row_num; i++) {
                 // matched
-                if (unique_set.find(res.get_row_col(i, col)) != unique_set.end()) {
+                if (edge_exist(edges, sz, res.get_row_col(i, col))) {
                     res.optional_matched_rows[i] = (true && res.optional_matched_rows[i]);
                 } else {
                     if (res.optional_matched_rows[i]) req.correct_optional_result(i);
@@ -295,7 +643,7 @@ private:
         } else {
             for (uint64_t i = 0; i < res.get_row_num(); i++) {
                 // matched
-                if (unique_set.find(res.get_row_col(i, col)) != unique_set.end())
+                if (edge_exist(edges, sz, res.get_row_col(i, col)))
                     res.append_row_to(i, updated_result_table);
             }
             res.result_table.swap(updated_result_table);
@@ -356,6 +704,41 @@ private:
         req.pattern_step++;
     }
 
+    // The rows are grouped by the start vertex before expansion if the same vertices are
+    // scattered (i.e., not in consecutive rows), so that the edges of a vertex are fetched
+    // only once. The grouping (a stable sort of row ids) is chosen only if it saves enough
+    // lookups over the dedup of consecutive same vertices.
+    // Return the order to visit rows, or an empty one for the original order.
+    vector<int> group_rows(SPARQLQuery::Result &res, int col) {
+        static const int MIN_ROWS = 256;   // too few rows to pay off
+        static const int MIN_SAVING = 8;   // save at least 1/MIN_SAVING lookups
+
+        vector<int> order;
+        int nrows = res.get_row_num();
+        if (nrows < MIN_ROWS)
+            return order;
+
+        // #lookups w/ and w/o grouping (#distinct and #consecutive runs of vertices)
+        boost::unordered_set<sid_t> distinct;
+        uint64_t runs = 0;
+        for (int i = 0; i < nrows; i++) {
+            sid_t cur = res.get_row_col(i, col);
+            if (i == 0 || cur != res.get_row_col(i - 1, col))
+                runs++;
+            distinct.insert(cur);
+        }
+        if ((runs - distinct.size()) * MIN_SAVING < (uint64_t)nrows)
+            return order;
+
+        order.resize(nrows);
+        for (int i = 0; i < nrows; i++)
+            order[i] = i;
+        stable_sort(order.begin(), order.end(), [&res, col](int a, int b) {
+            return res.get_row_col(a, col) < res.get_row_col(b, col);
+        });
+        return order;
+    }
+
     void known_to_unknown(SPARQLQuery &req) {
         SPARQLQuery::Pattern &pattern = req.get_pattern();
         ssid_t start = pattern.subject;
@@ -373,11 +756,23 @@ private:
         std::vector<attr_t> updated_attr_table;
         updated_attr_table.reserve(res.result_table.size());
 
-        // simple dedup for consecutive same vertices
-        sid_t cached = BLANK_ID;
+        // fetch the edges of all vertices in batches (w/ dedup for same vertices, see group_rows)
+        vector<int> order = group_rows(res, res.var2col(start));
+        Batch_Fetcher fetcher(graph, tid);
+        vector<uint64_t> key_ids(res.get_row_num(), 0);
+        for (int r = 0; r < res.get_row_num(); r++) {
+            int i = order.empty() ? r : order[r];
+            sid_t cur = res.get_row_col(i, res.var2col(start));
+            if (req.pg_type == SPARQLQuery::PGType::OPTIONAL &&
+                    (!res.optional_matched_rows[i] || cur == BLANK_ID))
+                continue;
+            key_ids[i] = fetcher.add(cur, d, pid);
+        }
+
         edge_t *edges = NULL;
         uint64_t sz = 0;
-        for (int i = 0; i < res.get_row_num(); i++) {
+        for (int r = 0; r < res.get_row_num(); r++) {
+            int i = order.empty() ? r : order[r];
             sid_t cur = res.get_row_col(i, res.var2col(start));
             if (req.pg_type == SPARQLQuery::PGType::OPTIONAL &&
                     (!res.optional_matched_rows[i] || cur == BLANK_ID)) {
@@ -386,10 +781,7 @@ private:
                 updated_optional_matched_rows.push_back(res.optional_matched_rows[i]);
                 continue;
             }
-            if (cur != cached) {  // a new vertex
-                cached = cur;
-                edges = graph->get_edges_global(tid, cur, d, pid, &sz);
-            }
+            edges = fetcher.get(key_ids[i], &sz);
 
             // append a new intermediate result (row)
             if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
@@ -424,6 +816,144 @@ private:
         req.pattern_step++;
     }
 
+    // Return the number of patterns consecutively following current pattern (?Y P ?Z, ?Z is
+    // UNKNOWN), which close a cycle on ?Z, i.e., ?X P' ?Z or ?Z P' ?X (?X is KNOWN).
+    int cycle_closers(SPARQLQuery &req) {
+        if (req.pg_type == SPARQLQuery::PGType::OPTIONAL)
+            return 0;
+
+        SPARQLQuery::Result &res = req.result;
+        ssid_t end = req.get_pattern().object;
+        int n = 0;
+        for (int step = req.pattern_step + 1; step < req.pattern_group.patterns.size(); step++) {
+            // keep the step of co-run optimization
+            if (req.corun_enabled && step == req.corun_step)
+                break;
+
+            SPARQLQuery::Pattern &pattern = req.get_pattern(step);
+            if (res.variable_type(pattern.predicate) != const_var
+                    || (global_enable_vattr && pattern.pred_type > 0))
+                break;
+
+            ssid_t other = end;
+            if (pattern.object == end)
+                other = pattern.subject;
+            else if (pattern.subject == end)
+                other = pattern.object;
+            if (other == end || res.variable_type(other) != known_var)
+                break;
+            n++;
+        }
+        return n;
+    }
+
+    /// ?Y P1 ?Z . ?X P2 ?Z . (?Y and ?X are KNOWN, ?Z is UNKNOWN)
+    /// e.g.,
+    ///
+    /// 1) Use [?Y]+P1 and [?X]+P2 (and so on for all @nclosers cycle-closing patterns)
+    ///    to retrieve all of neighbors
+    /// 2) Bind [?Z] to the values within all above neighbors (leapfrog intersection)
+    ///
+    /// It is a worst-case optimal join of the patterns, which never materializes the rows
+    /// of ?Z only to be pruned by the closing patterns (see known_to_unknown and known_to_known).
+    void known_to_unknown_cyclic(SPARQLQuery &req, int nclosers) {
+        SPARQLQuery::Pattern &pattern = req.get_pattern();
+        ssid_t end = pattern.object;
+        SPARQLQuery::Result &res = req.result;
+
+        // the known vertex (column), direction and predicate of every neighbor list
+        int nlists = nclosers + 1;
+        vector<int> cols(nlists);
+        vector<dir_t> dirs(nlists);
+        vector<ssid_t> preds(nlists);
+        for (int i = 0; i < nlists; i++) {
+            SPARQLQuery::Pattern &p = req.get_pattern(req.pattern_step + i);
+            if (p.object == end) {
+                cols[i] = res.var2col(p.subject);
+                dirs[i] = p.direction;
+            } else {
+                cols[i] = res.var2col(p.object);
+                dirs[i] = (p.direction == IN) ? OUT : IN;
+            }
+            preds[i] = p.predicate;
+        }
+
+        vector<sid_t> updated_result_table;
+        vector<attr_t> updated_attr_table;
+
+        // the edges are fetched to the (per-thread) buffer of GStore, which is reused
+        // by the next lookup, so all lists except the last one are copied out
+        // (w/ simple dedup for consecutive same vertices)
+        vector<vector<edge_t>> copies(nlists - 1);
+        vector<sid_t> cached(nlists - 1, BLANK_ID);
+        vector<edge_t *> lists(nlists);
+        vector<uint64_t> szs(nlists), pos(nlists);
+        for (int r = 0; r < res.get_row_num(); r++) {
+            bool empty = false;
+            for (int i = 0; i < nlists && !empty; i++) {
+                sid_t cur = res.get_row_col(r, cols[i]);
+                if (i < nlists - 1 && cur == cached[i]) {
+                    empty = copies[i].empty();
+                    continue;
+                }
+
+                uint64_t sz = 0;
+                edge_t *edges = graph->get_edges_global(tid, cur, dirs[i], preds[i], &sz);
+                if (i < nlists - 1) {
+                    cached[i] = cur;
+                    copies[i].assign(edges, edges + sz);
+                } else {
+                    lists[i] = edges;
+                    szs[i] = sz;
+                }
+                empty = (sz == 0);
+            }
+            if (empty) continue;
+
+            for (int i = 0; i < nlists - 1; i++) {
+                lists[i] = copies[i].data();
+                szs[i] = copies[i].size();
+            }
+
+            // leapfrog: seek every list in turn to the largest value seen (@val),
+            // and the value is matched once all lists agree on it
+            std::fill(pos.begin(), pos.end(), 0);
+            sid_t val = lists[0][0].val;
+            int agreed = 1, i = 1;
+            while (true) {
+                pos[i] = edge_gallop(lists[i], pos[i], szs[i], val);
+                if (pos[i] == szs[i])
+                    break;
+
+                if (lists[i][pos[i]].val == val) {
+                    if (++agreed == nlists) {
+                        // append a new intermediate result (row)
+                        res.append_row_to(r, updated_result_table);
+                        if (global_enable_vattr)
+                            res.append_attr_row_to(r, updated_attr_table);
+                        updated_result_table.push_back(val);
+
+                        if (++pos[i] == szs[i])
+                            break;
+                        val = lists[i][pos[i]].val;
+                        agreed = 1;
+                    }
+                } else {
+                    val = lists[i][pos[i]].val;
+                    agreed = 1;
+                }
+                i = (i + 1) % nlists;
+            }
+        }
+
+        res.result_table.swap(updated_result_table);
+        if (global_enable_vattr)
+            res.attr_res_table.swap(updated_attr_table);
+        res.add_var2col(end, res.get_col_num());
+        res.set_col_num(res.get_col_num() + 1);
+        req.pattern_step += nlists;
+    }
+
     // query the attribute starts from known to attribute value
     void known_to_unknown_attr(SPARQLQuery &req) {
         // prepare for query
@@ -480,38 +1010,47 @@ private:
         vector<sid_t> updated_result_table;
         vector<attr_t> updated_attr_table;
 
-        // simple dedup for consecutive same vertices
-        sid_t cached = BLANK_ID;
+        // fetch the edges of all vertices in batches (w/ dedup for same vertices, see group_rows)
+        vector<int> order = group_rows(res, res.var2col(start));
+        Batch_Fetcher fetcher(graph, tid);
+        vector<uint64_t> key_ids(res.get_row_num());
+        for (int r = 0; r < res.get_row_num(); r++) {
+            int i = order.empty() ? r : order[r];
+            key_ids[i] = fetcher.add(res.get_row_col(i, res.var2col(start)), d, pid);
+        }
+
+        uint64_t cached = UINT64_MAX;
         edge_t *edges = NULL;
         uint64_t sz = 0;
-        for (int i = 0; i < res.get_row_num(); i++) {
-            sid_t cur = res.get_row_col(i, res.var2col(start));
-            if (cur != cached) {  // a new vertex
-                cached = cur;
-                edges = graph->get_edges_global(tid, cur, d, pid, &sz);
+        // the edges are sorted, the rows of a vertex usually probe its edges
+        // in ascending order (a merge-like intersection), so gallop from the last position
+        sid_t last = BLANK_ID;
+        uint64_t pos = 0;
+        for (int r = 0; r < res.get_row_num(); r++) {
+            int i = order.empty() ? r : order[r];
+            if (key_ids[i] != cached) {  // a new vertex
+                cached = key_ids[i];
+                edges = fetcher.get(cached, &sz);
+                last = BLANK_ID;
+                pos = 0;
             }
 
             sid_t known = res.get_row_col(i, res.var2col(end));
+            if (last == BLANK_ID || known < last)
+                pos = edge_lower_bound(edges, 0, sz, known);
+            else
+                pos = edge_gallop(edges, pos, sz, known);
+            last = known;
+
+            bool matched = (pos < sz && edges[pos].val == known);
             if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
-                bool matched = false;
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (edges[k].val == known) {
-                        matched = true;
-                        break;
-                    }
-                }
                 if (res.optional_matched_rows[i] && (!matched)) req.correct_optional_result(i);
                 res.optional_matched_rows[i] = (matched && res.optional_matched_rows[i]);
-            } else {
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (edges[k].val == known) {
-                        // append a matched intermediate result
-                        res.append_row_to(i, updated_result_table);
-                        if (global_enable_vattr)
-                            res.append_attr_row_to(i, updated_attr_table);
-                        break;
-                    }
-                }
+            } else if (matched) {
+                // append a matched intermediate result
+                res.append_row_to(i, updated_result_table);
+                if (global_enable_vattr)
+                    res.append_attr_row_to(i, updated_attr_table);
             }
         }
         if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
@@ -550,16 +1089,14 @@ private:
                 cached = cur;
                 edges = graph->get_edges_global(tid, cur, d, pid, &sz);
 
-                for (uint64_t k = 0; k < sz; k++) {
-                    if (edges[k].val == end) {
-                        // append a matched intermediate result
-                        exist = true;
-                        if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
-                            res.append_row_to(i, updated_result_table);
-                            if (global_enable_vattr)
-                                res.append_attr_row_to(i, updated_attr_table);
-                        }
-                        break;
+                // the edges are sorted
+                if (edge_exist(edges, sz, end)) {
+                    // append a matched intermediate result
+                    exist = true;
+                    if (req.pg_type != SPARQLQuery::PGType::OPTIONAL) {
+                        res.append_row_to(i, updated_result_table);
+                        if (global_enable_vattr)
+                            res.append_attr_row_to(i, updated_attr_table);
                     }
                 }
                 if (req.pg_type == SPARQLQuery::PGType::OPTIONAL) {
@@ -770,6 +1307,16 @@ private:
             sub_reqs[i].local_var = start;
             sub_reqs[i].priority = req.priority + 1;
 
+            // sub-queries also stop early for LIMIT (see execute_limited)
+            sub_reqs[i].limit = req.limit;
+            sub_reqs[i].offset = req.offset;
+            sub_reqs[i].distinct = req.distinct;
+            sub_reqs[i].orders = req.orders;
+
+            // sub-queries reply partial aggregates (see aggregate)
+            sub_reqs[i].group_vars = req.group_vars;
+            sub_reqs[i].aggregates = req.aggregates;
+
             sub_reqs[i].result.col_num = req.result.col_num;
             sub_reqs[i].result.attr_col_num = req.result.attr_col_num;
             sub_reqs[i].result.blind = req.result.blind;
@@ -791,7 +1338,10 @@ private:
     }
 
     // fork-join or in-place execution
+    // NOTE: the estimate of the model is kept in fj_est (invalid if not used)
     bool need_fork_join(SPARQLQuery &req) {
+        fj_est.valid = false;
+
         // always need NOT fork-join when executing on single machine
         if (global_num_servers == 1) return false;
 
@@ -800,47 +1350,239 @@ private:
 
         SPARQLQuery::Pattern &pattern = req.get_pattern();
         ASSERT(req.result.variable_type(pattern.subject) == known_var);
-        //ssid_t start = pattern.subject;
-        //return ((req.local_var != start)
-        //        && (req.result.get_row_num() >= global_rdma_threshold));
-        return (req.result.get_row_num() >= global_rdma_threshold); // FIXME: not consider dedup
+        if (!global_enable_adaptive_forkjoin)
+            return (req.result.get_row_num() >= global_rdma_threshold);
+
+        uint64_t hits, misses;
+        graph->get_cache_stats(tid, hits, misses);
+        fj_model.update_cache_stats(hits, misses);
+
+        fj_est = fj_model.estimate(req.result, req.result.var2col(pattern.subject), sid);
+        return (fj_est.fork_us < fj_est.in_place_us);
     }
 
-    void do_corun(SPARQLQuery &req) {
-        SPARQLQuery::Result &req_result = req.result;
-        int corun_step = req.corun_step;
-        int fetch_step = req.fetch_step;
+    // Whether to split current pattern of the query into morsels (intra-query parallelism)
+    bool need_morsels(SPARQLQuery &req) {
+        if (global_morsel_size == 0 || global_num_engines == 1)
+            return false;
 
-        // step.1 remove dup;
-        uint64_t t0 = timer::get_usec();
+        // only the patterns starting from KNOWN are executed row by row
+        SPARQLQuery::Pattern &pattern = req.get_pattern();
+        if (req.pattern_step == 0 || req.result.variable_type(pattern.subject) != known_var)
+            return false;
 
-        boost::unordered_set<sid_t> unique_set;
-        ssid_t vid = req.get_pattern(corun_step).subject;
-        ASSERT(vid < 0);
-        int col_idx = req_result.var2col(vid);
-        for (int i = 0; i < req_result.get_row_num(); i++)
-            unique_set.insert(req_result.get_row_col(i, col_idx));
+        return (req.result.get_row_num() >= 2 * global_morsel_size);
+    }
 
-        // step.2 generate cmd_chain for sub-reqs
-        SPARQLQuery::PatternGroup subgroup;
-        vector<int> pvars_map; // from new_id to col_idx of id
+    void execute_morsel(Morsel *m) {
+        if (m->task)
+            m->task();
+        else
+            execute_one_pattern(m->req);
+        __sync_fetch_and_sub(m->pending, 1);
+    }
 
-        boost::unordered_map<sid_t, sid_t> sub_pvars;
+    // Run @func(i) for all i in [0, @n) by morsels, which are executed by all idle engines
+    // of the server. The engine also executes morsels till all its morsels are done.
+    void parallel_for(uint64_t n, std::function<void(uint64_t)> func) {
+        int ntasks = min<uint64_t>(n, global_num_engines * 4);
+        if (global_morsel_size == 0 || ntasks <= 1) {
+            for (uint64_t i = 0; i < n; i++)
+                func(i);
+            return;
+        }
 
-        auto lambda = [&](ssid_t id) -> ssid_t {
-            if (id < 0) { // remap pattern variable
-                if (sub_pvars.find(id) == sub_pvars.end()) {
-                    sid_t new_id = - (sub_pvars.size() + 1); // starts from -1
-                    sub_pvars[id] = new_id;
-                    pvars_map.push_back(req_result.var2col(id));
-                }
-                return sub_pvars[id];
-            } else {
-                return id;
-            }
-        };
+        volatile int pending = ntasks;
+        vector<Morsel> morsels(ntasks);
+        for (int t = 0; t < ntasks; t++) {
+            morsels[t].task = [&func, t, ntasks, n]() {
+                for (uint64_t i = t; i < n; i += ntasks)
+                    func(i);
+            };
+            morsels[t].pending = &pending;
+            morsel_pool.push(&morsels[t]);
+        }
 
-        for (int i = corun_step; i < fetch_step; i++) {
+        while (pending > 0) {
+            Morsel *m = morsel_pool.pop();
+            if (m != NULL)
+                execute_morsel(m);
+        }
+    }
+
+    // Initialize @sub_req to execute current pattern of @req on the rows [@first, @last)
+    void slice_query(SPARQLQuery &req, int first, int last, SPARQLQuery &sub_req) {
+        SPARQLQuery::Result &res = req.result;
+
+        sub_req.pg_type = req.pg_type;
+        sub_req.pattern_group = req.pattern_group;
+        sub_req.pattern_step = req.pattern_step;
+        sub_req.corun_enabled = req.corun_enabled;
+        sub_req.corun_step = req.corun_step;
+        sub_req.fetch_step = req.fetch_step;
+
+        SPARQLQuery::Result &sub_res = sub_req.result;
+        sub_res.col_num = res.col_num;
+        sub_res.attr_col_num = res.attr_col_num;
+        sub_res.v2c_map = res.v2c_map;
+        sub_res.nvars = res.nvars;
+        sub_res.blind = false; // must take back results
+        sub_res.result_table.assign(res.result_table.begin() + first * res.col_num,
+                                    res.result_table.begin() + last * res.col_num);
+        if (res.attr_col_num > 0)
+            sub_res.attr_res_table.assign(res.attr_res_table.begin() + first * res.attr_col_num,
+                                          res.attr_res_table.begin() + last * res.attr_col_num);
+        if (req.pg_type == SPARQLQuery::PGType::OPTIONAL)
+            sub_res.optional_matched_rows.assign(res.optional_matched_rows.begin() + first,
+                                                 res.optional_matched_rows.begin() + last);
+    }
+
+    // Whether to execute the last pattern of the query until the rows are enough for LIMIT
+    bool need_limited(SPARQLQuery &req) {
+        int64_t need = req.enough_rows();
+        if (need < 0)
+            return false;
+
+        // only the patterns starting from KNOWN are executed row by row
+        SPARQLQuery::Pattern &pattern = req.get_pattern();
+        if (req.pattern_step == 0
+                || req.pattern_step != req.pattern_group.patterns.size() - 1
+                || req.result.variable_type(pattern.subject) != known_var)
+            return false;
+
+        return (req.result.get_row_num() > max<int64_t>(need, LIMIT_SLICE_ROWS));
+    }
+
+    // Execute the last pattern of the query on growing slices of rows, and stop once the rows
+    // are enough for LIMIT (see SPARQLQuery::enough_rows), since the rest are never returned.
+    void execute_limited(SPARQLQuery &req) {
+        SPARQLQuery::Result &res = req.result;
+        int64_t need = req.enough_rows();
+        int nrows = res.get_row_num();
+
+        vector<sid_t> table;
+        vector<attr_t> attr_table;
+        int64_t len = max<int64_t>(need, LIMIT_SLICE_ROWS);
+        int first = 0, got = 0;
+        SPARQLQuery sub_req;
+        do {
+            int last = min<int64_t>(nrows, first + len);
+            sub_req = SPARQLQuery();
+            slice_query(req, first, last, sub_req);
+            execute_one_pattern(sub_req);
+
+            SPARQLQuery::Result &sub_res = sub_req.result;
+            table.insert(table.end(), sub_res.result_table.begin(), sub_res.result_table.end());
+            attr_table.insert(attr_table.end(),
+                              sub_res.attr_res_table.begin(), sub_res.attr_res_table.end());
+            got += sub_res.get_row_num();
+            first = last;
+            len *= 2; // grow the slice if the pattern is selective
+        } while (first < nrows && got < need);
+
+        logstream(LOG_DEBUG) << "[" << sid << "-" << tid << "]"
+                             << " stop at row " << first << "/" << nrows
+                             << " with " << got << " rows for LIMIT" << LOG_endl;
+
+        res.col_num = sub_req.result.col_num;
+        res.attr_col_num = sub_req.result.attr_col_num;
+        res.v2c_map = sub_req.result.v2c_map;
+        if (got > need) {
+            table.resize(need * res.col_num);
+            attr_table.resize(need * res.attr_col_num);
+        }
+        res.result_table.swap(table);
+        res.attr_res_table.swap(attr_table);
+        req.pattern_step = sub_req.pattern_step;
+    }
+
+    // Execute current pattern of the query by morsels of (global_morsel_size) rows, which are
+    // pulled from the pool by all idle engines of the server, and merge the partial results
+    // locally. The engine also executes morsels (of any query) till all its morsels are done.
+    void execute_morsels(SPARQLQuery &req) {
+        SPARQLQuery::Result &res = req.result;
+        int nrows = res.get_row_num();
+        int nmorsels = (nrows + global_morsel_size - 1) / global_morsel_size;
+
+        volatile int pending = nmorsels;
+        vector<Morsel> morsels(nmorsels);
+        for (int i = 0; i < nmorsels; i++) {
+            int first = i * global_morsel_size;
+            int last = min(nrows, first + global_morsel_size);
+            slice_query(req, first, last, morsels[i].req);
+            morsels[i].pending = &pending;
+        }
+
+        // release the input rows (copied to morsels)
+        vector<sid_t>().swap(res.result_table);
+        vector<attr_t>().swap(res.attr_res_table);
+        res.optional_matched_rows.clear();
+
+        for (int i = 0; i < nmorsels; i++)
+            morsel_pool.push(&morsels[i]);
+
+        while (pending > 0) {
+            Morsel *m = morsel_pool.pop();
+            if (m != NULL)
+                execute_morsel(m);
+        }
+
+        // merge the results of morsels (in order)
+        for (int i = 0; i < nmorsels; i++) {
+            SPARQLQuery::Result &sub_res = morsels[i].req.result;
+            res.result_table.insert(res.result_table.end(),
+                                    sub_res.result_table.begin(), sub_res.result_table.end());
+            res.attr_res_table.insert(res.attr_res_table.end(),
+                                      sub_res.attr_res_table.begin(), sub_res.attr_res_table.end());
+            if (req.pg_type == SPARQLQuery::PGType::OPTIONAL)
+                res.optional_matched_rows.insert(res.optional_matched_rows.end(),
+                                                 sub_res.optional_matched_rows.begin(),
+                                                 sub_res.optional_matched_rows.end());
+        }
+        res.col_num = morsels[0].req.result.col_num;
+        res.attr_col_num = morsels[0].req.result.attr_col_num;
+        res.v2c_map = morsels[0].req.result.v2c_map;
+        req.pattern_step = morsels[0].req.pattern_step;
+    }
+
+    void do_corun(SPARQLQuery &req) {
+        SPARQLQuery::Result &req_result = req.result;
+        int corun_step = req.corun_step;
+        int fetch_step = req.fetch_step;
+
+        // step.1 remove dup;
+        uint64_t t0 = timer::get_usec();
+
+        vector<sid_t> unique_vids;
+        ssid_t vid = req.get_pattern(corun_step).subject;
+        ASSERT(vid < 0);
+        int col_idx = req_result.var2col(vid);
+        unique_vids.reserve(req_result.get_row_num());
+        for (int i = 0; i < req_result.get_row_num(); i++)
+            unique_vids.push_back(req_result.get_row_col(i, col_idx));
+        sort(unique_vids.begin(), unique_vids.end());
+        unique_vids.erase(unique(unique_vids.begin(), unique_vids.end()), unique_vids.end());
+
+        // step.2 generate cmd_chain for sub-reqs
+        SPARQLQuery::PatternGroup subgroup;
+        vector<int> pvars_map; // from new_id to col_idx of id
+
+        boost::unordered_map<sid_t, sid_t> sub_pvars;
+
+        auto lambda = [&](ssid_t id) -> ssid_t {
+            if (id < 0) { // remap pattern variable
+                if (sub_pvars.find(id) == sub_pvars.end()) {
+                    sid_t new_id = - (sub_pvars.size() + 1); // starts from -1
+                    sub_pvars[id] = new_id;
+                    pvars_map.push_back(req_result.var2col(id));
+                }
+                return sub_pvars[id];
+            } else {
+                return id;
+            }
+        };
+
+        for (int i = corun_step; i < fetch_step; i++) {
             SPARQLQuery::Pattern &pattern = req.get_pattern(i);
             ssid_t subject = lambda(pattern.subject);
             ssid_t predicate = lambda(pattern.predicate);
@@ -860,9 +1602,7 @@ private:
         sub_result.nvars = pvars_map.size();
 
         // result
-        boost::unordered_set<sid_t>::iterator iter;
-        for (iter = unique_set.begin(); iter != unique_set.end(); iter++)
-            sub_result.result_table.push_back(*iter);
+        sub_result.result_table.swap(unique_vids);
         sub_result.col_num = 1;
 
         //init var_map
@@ -879,52 +1619,27 @@ private:
         }
         uint64_t t2 = timer::get_usec(); // time to run the sub-request
 
-        uint64_t t3, t4;
-        vector<sid_t> updated_result_table;
-
-        if (sub_result.get_col_num() > 2) { // qsort
-            mytuple::qsort_tuple(sub_result.get_col_num(), sub_result.result_table);
+        // step.5 semi-join the result with the sub-result on all variables of the sub-request
+        vector<int> sub_cols(pvars_map.size()); // from new_id to col_idx of id (in the sub-result)
+        for (int c = 0; c < pvars_map.size(); c++)
+            sub_cols[c] = sub_result.var2col(- (c + 1));
 
-            t3 = timer::get_usec();
-            vector<sid_t> tmp_vec;
-            tmp_vec.resize(sub_result.get_col_num());
-            for (int i = 0; i < req_result.get_row_num(); i++) {
-                for (int c = 0; c < pvars_map.size(); c++)
-                    tmp_vec[c] = req_result.get_row_col(i, pvars_map[c]);
+        Radix_Join join;
+        join.build(sub_result.result_table, sub_result.get_col_num(), sub_cols);
+        uint64_t t3 = timer::get_usec(); // time to build hash tables
 
-                if (mytuple::binary_search_tuple(sub_result.get_col_num(),
-                                                 sub_result.result_table, tmp_vec))
-                    req_result.append_row_to(i, updated_result_table);
-            }
-            t4 = timer::get_usec();
-        } else { // hash join
-            boost::unordered_set<int64_pair> remote_set;
-            for (int i = 0; i < sub_result.get_row_num(); i++)
-                remote_set.insert(int64_pair(sub_result.get_row_col(i, 0),
-                                             sub_result.get_row_col(i, 1)));
-
-            t3 = timer::get_usec();
-            vector<sid_t> tmp_vec;
-            tmp_vec.resize(sub_result.get_col_num());
-            for (int i = 0; i < req_result.get_row_num(); i++) {
-                for (int c = 0; c < pvars_map.size(); c++)
-                    tmp_vec[c] = req_result.get_row_col(i, pvars_map[c]);
-
-                int64_pair target = int64_pair(tmp_vec[0], tmp_vec[1]);
-                if (remote_set.find(target) != remote_set.end())
-                    req_result.append_row_to(i, updated_result_table);
-            }
-            t4 = timer::get_usec();
-        }
+        vector<bool> matched;
+        join.semi_join(req_result.result_table, req_result.get_col_num(), pvars_map, matched);
+        req_result.select_rows(matched);
+        uint64_t t4 = timer::get_usec(); // time to probe hash tables
 
         if (sid == 0 && tid == 0) {
             logstream(LOG_DEBUG) << "Prepare " << (t1 - t0) << " us" << LOG_endl;
             logstream(LOG_DEBUG) << "Execute sub-request " << (t2 - t1) << " us" << LOG_endl;
-            logstream(LOG_DEBUG) << "Sort " << (t3 - t2) << " us" << LOG_endl;
-            logstream(LOG_DEBUG) << "Lookup " << (t4 - t3) << " us" << LOG_endl;
+            logstream(LOG_DEBUG) << "Build " << (t3 - t2) << " us" << LOG_endl;
+            logstream(LOG_DEBUG) << "Probe " << (t4 - t3) << " us" << LOG_endl;
         }
 
-        req_result.result_table.swap(updated_result_table);
         req.pattern_step = fetch_step;
     }
 
@@ -1052,9 +1767,14 @@ private:
         case const_pair(known_var, known_var):
             known_to_known(req);
             break;
-        case const_pair(known_var, unknown_var):
-            known_to_unknown(req);
+        case const_pair(known_var, unknown_var): {
+            int nclosers = cycle_closers(req);
+            if (nclosers > 0)
+                known_to_unknown_cyclic(req, nclosers);
+            else
+                known_to_unknown(req);
             break;
+        }
 
         // start from UNKNOWN (incorrect query plan)
         case const_pair(unknown_var, const_var):
@@ -1074,73 +1794,134 @@ private:
         return true;
     }
 
+    // The typed value of an ID (or a constant) in FILTER
+    struct filter_value_t {
+        const string *str = NULL;
+        bool numeric = false; // a numeric literal (e.g., "12", "1.5"^^<...#double>)
+        double num = 0;
+    };
+
+    // The decoded values of the distinct IDs, shared by all filters of a query
+    typedef boost::unordered_map<sid_t, filter_value_t> filter_cache_t;
+
+    // The operand of a relational operator, compiled once per filter
+    struct filter_operand_t {
+        int col = -1;       // the column of a variable, or -1 for a constant
+        bool has_id = false; // the constant is a known string
+        sid_t id = 0;
+        string str;         // the string of the constant
+        filter_value_t val; // the value of the constant
+    };
+
+    // Decode the numeric value of a literal (the lexical form between quotes)
+    static bool decode_numeric(const string &str, double &num) {
+        if (str.size() < 3 || str[0] != '"')
+            return false;
+
+        size_t end = str.find('"', 1);
+        if (end == string::npos || end == 1)
+            return false;
+
+        string lex = str.substr(1, end - 1);
+        char c = lex[0];
+        if (!(isdigit(c) || c == '+' || c == '-' || c == '.')
+                || lex.find_first_of("xX") != string::npos)
+            return false;
+
+        char *tail = NULL;
+        num = strtod(lex.c_str(), &tail);
+        return (*tail == '\0');
+    }
+
+    void decode_value(const string &str, filter_value_t &val) {
+        val.str = &str;
+        val.numeric = decode_numeric(str, val.num);
+    }
+
+    const filter_value_t &lookup_value(sid_t id, filter_cache_t &cache) {
+        static const string empty;
+
+        filter_cache_t::iterator it = cache.find(id);
+        if (it != cache.end())
+            return it->second;
+
+        filter_value_t &val = cache[id];
+        decode_value(str_server->exist(id) ? str_server->id2str[id] : empty, val);
+        return val;
+    }
+
+    void compile_operand(SPARQLQuery::Filter &filter, SPARQLQuery::Result &result,
+                         filter_operand_t &opd) {
+        switch (filter.type) {
+        case SPARQLQuery::Filter::Type::Variable:
+            opd.col = result.var2col(filter.valueArg);
+            break;
+        case SPARQLQuery::Filter::Type::Literal:
+            // the constant is resolved to ID up front
+            opd.str = "\"" + filter.value + "\"";
+            opd.has_id = str_server->exist(opd.str);
+            if (opd.has_id)
+                opd.id = str_server->str2id[opd.str];
+            decode_value(opd.str, opd.val);
+            break;
+        default:
+            logstream(LOG_ERROR) << "Unsupported FILTER type" << LOG_endl;
+            ASSERT(false);
+        }
+    }
+
+    // compare the values numerically if both are numeric, otherwise by the strings
+    static inline int compare_value(const filter_value_t &a, const filter_value_t &b) {
+        if (a.numeric && b.numeric)
+            return (a.num < b.num) ? -1 : (a.num > b.num);
+        return a.str->compare(*b.str);
+    }
+
     // relational operator: < <= > >= == !=
+    // The operands are compiled once, and the rows are evaluated column-at-a-time on IDs.
+    // The strings of IDs are only decoded (once per distinct ID) for the numeric constants
+    // and the orderings.
     void relational_filter(SPARQLQuery::Filter &filter,
                            SPARQLQuery::Result &result,
-                           vector<bool> &is_satisfy) {
-        int col1 = (filter.arg1->type == SPARQLQuery::Filter::Type::Variable)
-                   ? result.var2col(filter.arg1->valueArg) : -1;
-        int col2 = (filter.arg2->type == SPARQLQuery::Filter::Type::Variable)
-                   ? result.var2col(filter.arg2->valueArg) : -1;
+                           vector<bool> &is_satisfy,
+                           filter_cache_t &cache) {
+        filter_operand_t a, b;
+        compile_operand(*filter.arg1, result, a);
+        compile_operand(*filter.arg2, result, b);
+
+        // a non-numeric constant is equal to the cells of the same ID only
+        bool equality = (filter.type == SPARQLQuery::Filter::Type::Equal
+                         || filter.type == SPARQLQuery::Filter::Type::NotEqual);
+        bool by_id = equality && ((a.col < 0 && !a.val.numeric) || (b.col < 0 && !b.val.numeric));
+
+        for (int row = 0; row < result.get_row_num(); row ++) {
+            if (!is_satisfy[row])
+                continue;
 
-        auto get_str = [&](SPARQLQuery::Filter & filter, int row, int col) -> string {
-            int id = 0;
+            sid_t ida = (a.col >= 0) ? result.get_row_col(row, a.col) : a.id;
+            sid_t idb = (b.col >= 0) ? result.get_row_col(row, b.col) : b.id;
+            bool known = (a.col >= 0 || a.has_id) && (b.col >= 0 || b.has_id);
+
+            int cmp;
+            if (equality && known && ida == idb)
+                cmp = 0;
+            else if (by_id)
+                cmp = 1;
+            else
+                cmp = compare_value((a.col >= 0) ? lookup_value(ida, cache) : a.val,
+                                    (b.col >= 0) ? lookup_value(idb, cache) : b.val);
+
+            bool sat = true;
             switch (filter.type) {
-            case SPARQLQuery::Filter::Type::Variable:
-                id = result.get_row_col(row, col);
-                return str_server->exist(id) ? str_server->id2str[id] : "";
-            case SPARQLQuery::Filter::Type::Literal:
-                return "\"" + filter.value + "\"";
-            default:
-                logstream(LOG_ERROR) << "Unsupported FILTER type" << LOG_endl;
-                ASSERT(false);
+            case SPARQLQuery::Filter::Type::Equal:          sat = (cmp == 0); break;
+            case SPARQLQuery::Filter::Type::NotEqual:       sat = (cmp != 0); break;
+            case SPARQLQuery::Filter::Type::Less:           sat = (cmp < 0);  break;
+            case SPARQLQuery::Filter::Type::LessOrEqual:    sat = (cmp <= 0); break;
+            case SPARQLQuery::Filter::Type::Greater:        sat = (cmp > 0);  break;
+            case SPARQLQuery::Filter::Type::GreaterOrEqual: sat = (cmp >= 0); break;
             }
-            return "";
-        };
-
-        switch (filter.type) {
-        case SPARQLQuery::Filter::Type::Equal:
-            for (int row = 0; row < result.get_row_num(); row ++)
-                if (is_satisfy[row]
-                        && (get_str(*filter.arg1, row, col1)
-                            != get_str(*filter.arg2, row, col2)))
-                    is_satisfy[row] = false;
-            break;
-        case SPARQLQuery::Filter::Type::NotEqual:
-            for (int row = 0; row < result.get_row_num(); row ++)
-                if (is_satisfy[row]
-                        && (get_str(*filter.arg1, row, col1)
-                            == get_str(*filter.arg2, row, col2)))
-                    is_satisfy[row] = false;
-            break;
-        case SPARQLQuery::Filter::Type::Less:
-            for (int row = 0; row < result.get_row_num(); row ++)
-                if (is_satisfy[row]
-                        && (get_str(*filter.arg1, row, col1)
-                            >= get_str(*filter.arg2, row, col2)))
-                    is_satisfy[row] = false;
-            break;
-        case SPARQLQuery::Filter::Type::LessOrEqual:
-            for (int row = 0; row < result.get_row_num(); row ++)
-                if (is_satisfy[row]
-                        && (get_str(*filter.arg1, row, col1)
-                            > get_str(*filter.arg2, row, col2)))
-                    is_satisfy[row] = false;
-            break;
-        case SPARQLQuery::Filter::Type::Greater:
-            for (int row = 0; row < result.get_row_num(); row ++)
-                if (is_satisfy[row]
-                        && (get_str(*filter.arg1, row, col1)
-                            <= get_str(*filter.arg2, row, col2)))
-                    is_satisfy[row] = false;
-            break;
-        case SPARQLQuery::Filter::Type::GreaterOrEqual:
-            for (int row = 0; row < result.get_row_num(); row ++)
-                if (is_satisfy[row]
-                        && get_str(*filter.arg1, row, col1)
-                        < get_str(*filter.arg2, row, col2))
-                    is_satisfy[row] = false;
-            break;
+            if (!sat)
+                is_satisfy[row] = false;
         }
     }
 
@@ -1211,54 +1992,149 @@ private:
         }
     }
 
+    // Return the longest run of ordinary characters that any match of the regex must
+    // contain (at the top level), or "" if unknown (e.g., with alternations).
+    static string required_literal(const string &re) {
+        if (re.find('|') != string::npos)
+            return "";
+
+        string best, cur;
+        auto cut = [&best, &cur]() {
+            if (cur.size() > best.size())
+                best = cur;
+            cur.clear();
+        };
+
+        int depth = 0; // the literals in groups may be optional
+        for (size_t i = 0; i < re.size(); i++) {
+            char c = re[i];
+            switch (c) {
+            case '\\': // an escape (e.g., \d)
+                cut();
+                i++;
+                break;
+            case '[': // skip the bracket expression
+                cut();
+                i++;
+                if (i < re.size() && re[i] == '^') i++;
+                if (i < re.size() && re[i] == ']') i++;
+                while (i < re.size() && re[i] != ']') {
+                    if (re[i] == '\\') i++;
+                    i++;
+                }
+                break;
+            case '(':
+                depth++;
+                cut();
+                break;
+            case ')':
+                depth--;
+                cut();
+                break;
+            case '*': case '?': case '{': // the last character is optional
+                if (!cur.empty())
+                    cur.erase(cur.size() - 1);
+                cut();
+                if (c == '{')
+                    while (i < re.size() && re[i] != '}') i++;
+                break;
+            case '+': case '.': case '^': case '$':
+                cut();
+                break;
+            default:
+                if (depth == 0)
+                    cur += c;
+            }
+        }
+        cut();
+        return best;
+    }
+
+    // the compiled regex is cached by the engine across queries
+    const regex &get_regex(const string &re, bool icase) {
+        static const int MAX_REGEXES = 64;
+
+        string key = (icase ? "i/" : "/") + re;
+        boost::unordered_map<string, regex>::iterator it = regexes.find(key);
+        if (it != regexes.end())
+            return it->second;
+
+        if (regexes.size() >= MAX_REGEXES)
+            regexes.clear();
+        regex &pattern = regexes[key];
+        pattern = icase ? regex(re, std::regex::icase) : regex(re);
+        return pattern;
+    }
+
+    bool regex_match_id(sid_t id, const regex &pattern, const string &literal, bool icase) {
+        string str = str_server->exist(id) ? str_server->id2str[id] : "";
+        if (str.size() < 2 || str.front() != '\"' || str.back() != '\"')
+            logstream(LOG_ERROR) << "The first parameter of function regex must be string"
+                                 << LOG_endl;
+        else
+            str = str.substr(1, str.length() - 2);
+
+        // prefilter by the required literal
+        if (!literal.empty()) {
+            bool found;
+            if (icase)
+                found = (search(str.begin(), str.end(), literal.begin(), literal.end(),
+                [](char a, char b) { return tolower(a) == tolower(b); }) != str.end());
+            else
+                found = (memmem(str.data(), str.size(), literal.data(), literal.size()) != NULL);
+            if (!found)
+                return false;
+        }
+
+        return regex_match(str, pattern);
+    }
+
     // regex flag only support "i" option now
+    // The results are memoized per distinct ID of the column.
     void regex_filter(SPARQLQuery::Filter &filter,
                       SPARQLQuery::Result &result,
                       vector<bool> &is_satisfy) {
-        regex pattern;
-        if (filter.arg3 != nullptr && filter.arg3->value == "i")
-            pattern = regex(filter.arg2->value, std::regex::icase);
-        else
-            pattern = regex(filter.arg2->value);
+        bool icase = (filter.arg3 != nullptr && filter.arg3->value == "i");
+        const regex &pattern = get_regex(filter.arg2->value, icase);
+        string literal = required_literal(filter.arg2->value);
 
+        boost::unordered_map<sid_t, bool> matched;
         int col = result.var2col(filter.arg1->valueArg);
         for (int row = 0; row < is_satisfy.size(); row ++) {
             if (!is_satisfy[row])
                 continue;
 
-            int id = result.get_row_col(row, col);
-            string str = str_server->exist(id) ? str_server->id2str[id] : "";
-            if (str.front() != '\"' || str.back() != '\"')
-                logstream(LOG_ERROR) << "The first parameter of function regex must be string"
-                                     << LOG_endl;
-            else
-                str = str.substr(1, str.length() - 2);
+            sid_t id = result.get_row_col(row, col);
+            boost::unordered_map<sid_t, bool>::iterator it = matched.find(id);
+            if (it == matched.end())
+                it = matched.emplace(id, regex_match_id(id, pattern, literal, icase)).first;
 
-            if (!regex_match(str, pattern))
+            if (!it->second)
                 is_satisfy[row] = false;
         }
     }
 
     void general_filter(SPARQLQuery::Filter &filter,
                         SPARQLQuery::Result &result,
-                        vector<bool> &is_satisfy) {
+                        vector<bool> &is_satisfy,
+                        filter_cache_t &cache) {
         // conditional operator
         if (filter.type <= 1) {
             vector<bool> is_satisfy1(result.get_row_num(), true);
             vector<bool> is_satisfy2(result.get_row_num(), true);
             if (filter.type == SPARQLQuery::Filter::Type::And) {
-                general_filter(*filter.arg1, result, is_satisfy);
-                general_filter(*filter.arg2, result, is_satisfy);
+                general_filter(*filter.arg1, result, is_satisfy, cache);
+                general_filter(*filter.arg2, result, is_satisfy, cache);
             } else if (filter.type == SPARQLQuery::Filter::Type::Or) {
-                general_filter(*filter.arg1, result, is_satisfy1);
-                general_filter(*filter.arg2, result, is_satisfy2);
+                general_filter(*filter.arg1, result, is_satisfy1, cache);
+                general_filter(*filter.arg2, result, is_satisfy2, cache);
                 for (int i = 0; i < is_satisfy.size(); i ++)
                     is_satisfy[i] = is_satisfy[i] && (is_satisfy1[i] || is_satisfy2[i]);
             }
         }
         // relational operator
         else if (filter.type <= 7)
-            return relational_filter(filter, result, is_satisfy);
+            return relational_filter(filter, result, is_satisfy, cache);
         else if (filter.type == SPARQLQuery::Filter::Type::Builtin_bound)
             return bound_filter(filter, result, is_satisfy);
         else if (filter.type == SPARQLQuery::Filter::Type::Builtin_isiri)
@@ -1276,184 +2152,411 @@ private:
         // during filtering, flag of unsatified row will be set to false one by one
         vector<bool> is_satisfy(r.result.get_row_num(), true);
 
+        filter_cache_t cache; // the decoded values of IDs
         for (int i = 0; i < r.pattern_group.filters.size(); i ++) {
-            SPARQLQuery::Filter filter = r.pattern_group.filters[i];
-            general_filter(filter, r.result, is_satisfy);
+            SPARQLQuery::Filter &filter = r.pattern_group.filters[i];
+            general_filter(filter, r.result, is_satisfy, cache);
         }
 
-        vector<sid_t> new_table;
-        for (int row = 0; row < r.result.get_row_num(); row ++) {
-            if (is_satisfy[row]) {
-                r.result.append_row_to(row, new_table);
-            }
+        r.result.select_rows(is_satisfy);
+    }
+
+    // NOTE: the unbound value (NaN) is the lowest, as in ORDER BY
+    static double attr2double(const attr_t &v) {
+        if (SPARQLQuery::Result::is_unbound_attr(v))
+            return -std::numeric_limits<double>::infinity();
+
+        switch (boost::apply_visitor(get_type, v)) {
+        case INT_t: return boost::get<int>(v);
+        case FLOAT_t: return boost::get<float>(v);
+        case DOUBLE_t: return boost::get<double>(v);
+        default: return 0;
         }
-        r.result.result_table.swap(new_table);
-        r.result.row_num = r.result.get_row_num();
     }
 
-    class Compare {
-    private:
-        SPARQLQuery &query;
-        String_Server *str_server;
-    public:
-        Compare(SPARQLQuery &query, String_Server *str_server)
-            : query(query), str_server(str_server) { }
-
-        bool operator()(const int* a, const int* b) {
-            int cmp = 0;
-            for (int i = 0; i < query.orders.size(); i ++) {
-                int col = query.result.var2col(query.orders[i].id);
-                string str_a = str_server->exist(a[col]) ? str_server->id2str[a[col]] : "";
-                string str_b = str_server->exist(a[col]) ? str_server->id2str[b[col]] : "";
-                cmp = str_a.compare(str_b);
-                if (cmp != 0) {
-                    cmp = query.orders[i].descending ? -cmp : cmp;
+    // The state of an aggregate for a group
+    struct agg_state_t {
+        int n = 0;    // #values (or #rows for COUNT)
+        double v = 0; // the sum (SUM, AVG), the min (MIN) or the max (MAX) of values
+    };
+
+    static void accumulate(agg_state_t &st, SPARQLQuery::Aggregate::Type type, int n, double v) {
+        if (n == 0)
+            return;
+
+        switch (type) {
+        case SPARQLQuery::Aggregate::Type::MIN:
+            st.v = (st.n > 0) ? min(st.v, v) : v;
+            break;
+        case SPARQLQuery::Aggregate::Type::MAX:
+            st.v = (st.n > 0) ? max(st.v, v) : v;
+            break;
+        default:
+            st.v += v;
+        }
+        st.n += n;
+    }
+
+    // GROUP BY and aggregates (COUNT, SUM, MIN, MAX and AVG)
+    // The rows (or partial aggregates) are grouped by the IDs of group variables, and the
+    // values are the numeric literals (or attributes) of aggregated variables.
+    // If not @final (i.e., sub-queries), a partial aggregate per group, i.e., (#values, value)
+    // of every aggregate in attribute columns, is replied instead of the rows, and the partial
+    // aggregates are merged by the parent and combined into the final values at last.
+    void aggregate(SPARQLQuery &r, bool final) {
+        SPARQLQuery::Result &res = r.result;
+        int nkeys = r.group_vars.size();
+        int naggs = r.aggregates.size();
+        int nrows = res.get_row_num();
+
+        vector<int> key_cols(nkeys);
+        for (int i = 0; i < nkeys; i++) {
+            if (res.aggregated) {
+                key_cols[i] = i;
+            } else {
+                key_cols[i] = res.var2col(r.group_vars[i]);
+                // attribute keys are rejected by the parser (see Parser::parse)
+                if (key_cols[i] != NO_RESULT && res.is_attr_col(r.group_vars[i])) {
+                    logstream(LOG_WARNING) << "Unsupported attribute variable in GROUP BY "
+                                           << "is ignored." << LOG_endl;
+                    key_cols[i] = NO_RESULT;
+                }
+            }
+        }
+        vector<int> agg_cols(naggs, NO_RESULT);
+        for (int a = 0; a < naggs; a++)
+            if (!res.aggregated && r.aggregates[a].id != 0)
+                agg_cols[a] = res.var2col(r.aggregates[a].id);
+
+        boost::unordered_map<vector<sid_t>, int> groups;
+        vector<sid_t> keys; // the keys of groups
+        vector<agg_state_t> states; // the states of aggregates of groups
+        filter_cache_t cache; // the decoded values of IDs
+        vector<sid_t> key(nkeys);
+        for (int row = 0; row < nrows; row++) {
+            for (int i = 0; i < nkeys; i++)
+                key[i] = (key_cols[i] == NO_RESULT) ? BLANK_ID : res.get_row_col(row, key_cols[i]);
+
+            int g;
+            boost::unordered_map<vector<sid_t>, int>::iterator it = groups.find(key);
+            if (it == groups.end()) {
+                g = groups.size();
+                groups.emplace(key, g);
+                keys.insert(keys.end(), key.begin(), key.end());
+                states.resize(states.size() + naggs);
+            } else {
+                g = it->second;
+            }
+
+            for (int a = 0; a < naggs; a++) {
+                SPARQLQuery::Aggregate &agg = r.aggregates[a];
+                agg_state_t &st = states[g * naggs + a];
+
+                // merge a partial aggregate
+                if (res.aggregated) {
+                    accumulate(st, agg.type,
+                               boost::get<int>(res.get_attr_row_col(row, 2 * a)),
+                               boost::get<double>(res.get_attr_row_col(row, 2 * a + 1)));
+                    continue;
+                }
+
+                if (agg.id == 0) { // COUNT(*)
+                    accumulate(st, agg.type, 1, 0);
+                    continue;
+                }
+
+                int col = agg_cols[a];
+                if (col == NO_RESULT)
+                    continue; // unbound
+
+                if (res.is_attr_col(agg.id)) {
+                    attr_t v = res.get_attr_row_col(row, col);
+                    if (!SPARQLQuery::Result::is_unbound_attr(v))
+                        accumulate(st, agg.type, 1, attr2double(v));
+                    continue;
+                }
+
+                sid_t id = res.get_row_col(row, col);
+                if (id == BLANK_ID)
+                    continue; // unbound (OPTIONAL)
+
+                if (agg.type == SPARQLQuery::Aggregate::Type::COUNT) {
+                    accumulate(st, agg.type, 1, 0);
+                } else {
+                    const filter_value_t &val = lookup_value(id, cache);
+                    if (val.numeric)
+                        accumulate(st, agg.type, 1, val.num);
+                }
+            }
+        }
+
+        // the aggregates of all rows (w/o GROUP BY) always have a row
+        if (final && nkeys == 0 && groups.empty())
+            states.resize(naggs);
+
+        int ngroups = states.size() / max(naggs, 1);
+        if (naggs == 0)
+            ngroups = groups.size();
+
+        vector<attr_t> attr_table;
+        attr_table.reserve(ngroups * naggs * (final ? 1 : 2));
+        for (int g = 0; g < ngroups; g++) {
+            for (int a = 0; a < naggs; a++) {
+                agg_state_t &st = states[g * naggs + a];
+                if (!final) {
+                    attr_table.push_back(st.n);
+                    attr_table.push_back(st.v);
+                    continue;
+                }
+
+                // the aggregates of no (numeric) values are unbound
+                switch (r.aggregates[a].type) {
+                case SPARQLQuery::Aggregate::Type::COUNT:
+                    attr_table.push_back(st.n);
+                    break;
+                case SPARQLQuery::Aggregate::Type::AVG:
+                    attr_table.push_back((st.n > 0) ? attr_t(st.v / st.n)
+                                         : SPARQLQuery::Result::unbound_attr());
                     break;
+                default:
+                    attr_table.push_back((st.n > 0) ? attr_t(st.v)
+                                         : SPARQLQuery::Result::unbound_attr());
                 }
             }
-            return cmp < 0;
         }
-    };
 
-    class ReduceCmp {
+        res.result_table.swap(keys);
+        res.attr_res_table.swap(attr_table);
+        res.col_num = nkeys;
+        res.attr_col_num = final ? naggs : 2 * naggs;
+        res.v2c_map.assign(res.nvars, NO_RESULT);
+        for (int i = 0; i < nkeys; i++)
+            res.add_var2col(r.group_vars[i], i);
+        if (final) {
+            for (int a = 0; a < naggs; a++)
+                res.add_var2col(r.aggregates[a].alias, a,
+                                (r.aggregates[a].type == SPARQLQuery::Aggregate::Type::COUNT)
+                                ? INT_t : DOUBLE_t);
+        }
+        res.optional_matched_rows.clear();
+        res.aggregated = !final;
+        res.row_num = ngroups;
+    }
+
+    // Compare the rows by ORDER BY keys, which are the order-preserving ranks of the strings
+    // of IDs, computed once per query for the distinct IDs of the rows (instead of comparing
+    // the strings).
+    class Compare {
     private:
-        int col_num;
-    public:
-        ReduceCmp(int col_num): col_num(col_num) { }
+        int norders;
+        vector<bool> descending;
+        vector<uint32_t> ranks; // row-major, the rank of every key of the rows
 
-        bool operator()(const int* a, const int* b) {
-            for (int i = 0; i < col_num; i ++) {
-                if (a[i] == b[i])
+    public:
+        Compare(SPARQLQuery &query, const vector<int> &rows, String_Server *str_server) {
+            SPARQLQuery::Result &res = query.result;
+            static const string empty;
+
+            norders = query.orders.size();
+            ranks.resize((uint64_t)res.get_row_num() * norders);
+            for (int i = 0; i < norders; i++) {
+                int col = res.var2col(query.orders[i].id);
+                descending.push_back(query.orders[i].descending);
+
+                // the values of attributes (e.g., aggregates) are ranked numerically
+                if (res.is_attr_col(query.orders[i].id)) {
+                    vector<double> vals;
+                    vals.reserve(rows.size());
+                    for (auto r : rows)
+                        vals.push_back(attr2double(res.get_attr_row_col(r, col)));
+                    sort(vals.begin(), vals.end());
+                    vals.erase(unique(vals.begin(), vals.end()), vals.end());
+
+                    for (auto r : rows) {
+                        double v = attr2double(res.get_attr_row_col(r, col));
+                        ranks[(uint64_t)r * norders + i] =
+                            lower_bound(vals.begin(), vals.end(), v) - vals.begin();
+                    }
                     continue;
-                return a[i] < b[i];
+                }
+
+                // the distinct IDs of the rows
+                vector<sid_t> ids;
+                ids.reserve(rows.size());
+                for (auto r : rows)
+                    ids.push_back(res.get_row_col(r, col));
+                sort(ids.begin(), ids.end());
+                ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+                // sort the IDs by their strings (looked up once)
+                vector<const string *> strs(ids.size());
+                for (int j = 0; j < ids.size(); j++)
+                    strs[j] = str_server->exist(ids[j]) ? &str_server->id2str[ids[j]] : &empty;
+                vector<int> order(ids.size());
+                for (int j = 0; j < order.size(); j++)
+                    order[j] = j;
+                sort(order.begin(), order.end(), [&strs](int a, int b) {
+                    return strs[a]->compare(*strs[b]) < 0;
+                });
+
+                // the same strings have the same rank
+                vector<uint32_t> id_ranks(ids.size());
+                uint32_t rank = 0;
+                for (int j = 0; j < order.size(); j++) {
+                    if (j > 0 && *strs[order[j]] != *strs[order[j - 1]])
+                        rank++;
+                    id_ranks[order[j]] = rank;
+                }
+
+                for (auto r : rows) {
+                    sid_t id = res.get_row_col(r, col);
+                    int j = lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+                    ranks[(uint64_t)r * norders + i] = id_ranks[j];
+                }
             }
-            return 0;
+        }
+
+        bool operator()(int a, int b) const {
+            const uint32_t *ka = &ranks[(uint64_t)a * norders];
+            const uint32_t *kb = &ranks[(uint64_t)b * norders];
+            for (int i = 0; i < norders; i++) {
+                if (ka[i] != kb[i])
+                    return descending[i] ? (ka[i] > kb[i]) : (ka[i] < kb[i]);
+            }
+            return false;
         }
     };
 
+    // The key of an attribute value (type and bits) to compare the values by equality,
+    // where the zeros (+0.0 and -0.0) and the NaNs (e.g., unbound) are respectively identical.
+    static pair<int, uint64_t> attr_key(const attr_t &v) {
+        uint64_t bits = 0;
+        switch (v.which()) {
+        case 0: {
+            bits = (uint32_t)boost::get<int>(v);
+            break;
+        }
+        case 1: {
+            double d = boost::get<double>(v);
+            if (d == 0) d = 0;
+            if (std::isnan(d)) d = std::numeric_limits<double>::quiet_NaN();
+            memcpy(&bits, &d, sizeof(d));
+            break;
+        }
+        case 2: {
+            float f = boost::get<float>(v);
+            if (f == 0) f = 0;
+            if (std::isnan(f)) f = std::numeric_limits<float>::quiet_NaN();
+            memcpy(&bits, &f, sizeof(f));
+            break;
+        }
+        }
+        return make_pair(v.which(), bits);
+    }
+
     void final_process(SPARQLQuery &r) {
-        if (r.result.blind || r.result.result_table.size() == 0)
+        if (r.result.blind || r.result.get_row_num() == 0)
             return;
 
-        // DISTINCT and ORDER BY
-        if (r.distinct || r.orders.size() > 0) {
-            // initialize table
-            int **table;
-            int size = r.result.get_row_num();
-            int new_size = size;
-
-            table = new int*[size];
-            for (int i = 0; i < size; i ++)
-                table[i] = new int[r.result.col_num];
-
-            for (int i = 0; i < size; i ++)
-                for (int j = 0; j < r.result.col_num; j ++)
-                    table[i][j] = r.result.get_row_col(i, j);
-
-            // DISTINCT
-            if (r.distinct) {
-                // sort and then compare
-                sort(table, table + size, ReduceCmp(r.result.col_num));
-                int p = 0, q = 1;
-                auto equal = [&r](int *a, int *b) -> bool{
-                    for (int i = 0; i < r.result.required_vars.size(); i ++) {
-                        int col = r.result.var2col(r.result.required_vars[i]);
-                        if (a[col] != b[col]) return false;
-                    }
-                    return true;
-                };
-
-                auto swap = [](int *&a, int *&b) {
-                    int *temp = a;
-                    a = b;
-                    b = temp;
-                };
-
-                while (q < size) {
-                    while (equal(table[p], table[q])) {
-                        q++;
-                        if (q >= size) goto out;
+        SPARQLQuery::Result &res = r.result;
+
+        // separate the requested variables to normal and attribute columns
+        vector<int> cols, attr_cols;
+        for (int i = 0; i < res.required_vars.size(); i++) {
+            ssid_t vid = res.required_vars[i];
+            if (res.is_attr_col(vid))
+                attr_cols.push_back(res.var2col(vid));
+            else
+                cols.push_back(res.var2col(vid));
+        }
+
+        // the selection vector (row IDs), the rows are only materialized at last
+        vector<int> rows(res.get_row_num());
+        for (int i = 0; i < rows.size(); i++)
+            rows[i] = i;
+
+        // DISTINCT (on requested variables)
+        if (r.distinct) {
+            if (cols.empty() && attr_cols.empty()) {
+                rows.resize(1); // all rows are identical
+            } else {
+                // the attribute values are mapped to dense IDs, and appended to the (copied)
+                // IDs of requested variables, so that the rows are deduplicated by IDs as well
+                vector<sid_t> keys;
+                vector<int> key_cols = cols;
+                int nkeys = res.get_col_num();
+                if (!attr_cols.empty()) {
+                    nkeys = cols.size() + attr_cols.size();
+                    keys.reserve((uint64_t)rows.size() * nkeys);
+                    boost::unordered_map<pair<int, uint64_t>, sid_t> attr_ids;
+                    for (int i = 0; i < rows.size(); i++) {
+                        for (auto c : cols)
+                            keys.push_back(res.get_row_col(i, c));
+                        for (auto c : attr_cols) {
+                            pair<int, uint64_t> v = attr_key(res.get_attr_row_col(i, c));
+                            auto it = attr_ids.emplace(v, (sid_t)attr_ids.size()).first;
+                            keys.push_back(it->second);
+                        }
                     }
-                    p ++;
-                    swap(table[p], table[q]);
-                    q ++;
+
+                    key_cols.resize(nkeys);
+                    for (int i = 0; i < nkeys; i++)
+                        key_cols[i] = i;
                 }
-out:
-                new_size = p + 1;
-            }
-            // ORDER BY
-            if (r.orders.size() > 0) {
-                sort(table, table + new_size, Compare(r, str_server));
+
+                // keep the first row of every distinct keys by partitioned hash tables
+                vector<char> first(rows.size(), false);
+                Radix_Join dedup;
+                uint64_t nparts = dedup.cluster(attr_cols.empty() ? res.result_table : keys,
+                                                nkeys, key_cols);
+                parallel_for(nparts, [&dedup, &first](uint64_t p) { dedup.distinct(p, first); });
+
+                int n = 0;
+                for (int i = 0; i < rows.size(); i++)
+                    if (first[i]) rows[n++] = i;
+                rows.resize(n);
             }
+        }
 
-            //write back data and delete **table
-            for (int i = 0; i < new_size; i ++)
-                for (int j = 0; j < r.result.col_num; j ++)
-                    r.result.result_table[r.result.col_num * i + j] = table[i][j];
+        // ORDER BY (only the top OFFSET + LIMIT rows are sorted by a bounded heap)
+        if (r.orders.size() > 0) {
+            Compare cmp(r, rows, str_server);
+            auto less = [&cmp](int a, int b) -> bool { return cmp(a, b); }; // w/o copying keys
 
-            if (new_size < size)
-                r.result.result_table.erase(r.result.result_table.begin() + new_size * r.result.col_num,
-                                            r.result.result_table.begin() + size * r.result.col_num);
+            size_t k = rows.size();
+            if (r.limit >= 0)
+                k = min<size_t>(k, (size_t)r.offset + r.limit);
 
-            for (int i = 0; i < size; i ++)
-                delete[] table[i];
-            delete[] table;
+            if (k < rows.size()) {
+                partial_sort(rows.begin(), rows.begin() + k, rows.end(), less);
+                rows.resize(k);
+            } else {
+                sort(rows.begin(), rows.end(), less);
+            }
         }
 
         // OFFSET
         if (r.offset > 0)
-            r.result.result_table.erase(r.result.result_table.begin(),
-                                        min(r.result.result_table.begin()
-                                            + r.offset * r.result.col_num,
-                                            r.result.result_table.end()));
+            rows.erase(rows.begin(), rows.begin() + min<size_t>(r.offset, rows.size()));
 
         // LIMIT
-        if (r.limit >= 0)
-            r.result.result_table.erase(min(r.result.result_table.begin()
-                                            + r.limit * r.result.col_num,
-                                            r.result.result_table.end()),
-                                        r.result.result_table.end() );
+        if (r.limit >= 0 && r.limit < rows.size())
+            rows.resize(r.limit);
 
         // remove unrequested variables
-        //separate var to normal and attribute
-        // need to think about attribute result table
-        vector<ssid_t> normal_var;
-        vector<ssid_t> attr_var;
-        for (int i = 0; i < r.result.required_vars.size(); i++) {
-            ssid_t vid = r.result.required_vars[i];
-            if (r.result.is_attr_col(vid)) {
-                attr_var.push_back(vid);
-            } else {
-                normal_var.push_back(vid);
-            }
-        }
-        int new_row_num = r.result.get_row_num();
-        int new_col_num = normal_var.size();
-        int new_attr_col_num = attr_var.size();
-
-        //update result table
-        vector<sid_t> new_result_table(new_row_num * new_col_num);
-        for (int i = 0; i < new_row_num; i ++) {
-            for (int j = 0; j < new_col_num; j++) {
-                int col = r.result.var2col(normal_var[j]);
-                new_result_table[i * new_col_num + j] = r.result.get_row_col(i, col);
-            }
-        }
-
-        r.result.result_table.swap(new_result_table);
-        r.result.col_num = new_col_num;
-        r.result.row_num = r.result.get_row_num();
+        res.materialize(rows, cols, attr_cols);
+    }
 
-        //update attribute result table
-        vector<attr_t> new_attr_result_table(new_row_num * new_attr_col_num);
-        for (int i = 0; i < new_row_num; i ++) {
-            for (int j = 0; j < new_attr_col_num; j++) {
-                int col = r.result.var2col(attr_var[j]);
-                new_attr_result_table[i * new_attr_col_num + j] = r.result.get_attr_row_col(i, col);
-            }
-        }
-        r.result.attr_res_table.swap(new_attr_result_table);
-        r.result.attr_col_num = new_attr_col_num;
+    // Register @r waiting for @cnt replies to the map of the engine which owns the id of @r,
+    // since the replies are routed by the id (see send_reply).
+    // NOTE: the query may be executed by another engine on behalf of it (see steal_work),
+    //       and a stolen query without id is assigned one by the executing engine.
+    void put_parent_request(SPARQLQuery &r, int cnt, uint64_t fork_rows = 0) {
+        ASSERT(coder.sid_of(r.id) == sid);
+        Engine *engine = engines[coder.tid_of(r.id) - global_num_proxies];
+        pthread_spin_lock(&engine->rmap_lock);
+        engine->rmap.put_parent_request(r, cnt, fork_rows);
+        pthread_spin_unlock(&engine->rmap_lock);
     }
 
     bool execute_patterns(SPARQLQuery &r) {
@@ -1468,7 +2571,7 @@ out:
             // but must smaller than global_mt_threshold (Default: mt_factor == 1)
             // Normally, we will NOT let global_mt_threshold == #engines, which will cause HANG
             int sub_reqs_size = global_num_servers * r.mt_factor;
-            rmap.put_parent_request(r, sub_reqs_size);
+            put_parent_request(r, sub_reqs_size);
             SPARQLQuery sub_query = r;
             for (int i = 0; i < global_num_servers; i++) {
                 for (int j = 0; j < r.mt_factor; j++) {
@@ -1489,8 +2592,18 @@ out:
             return false;
         }
 
+        bool in_place = false; // the pattern is chosen in-place by the cost model
         do {
-            execute_one_pattern(r);
+            uint64_t start_time = timer::get_usec();
+            if (need_limited(r)) {
+                execute_limited(r);
+            } else if (need_morsels(r)) {
+                execute_morsels(r);
+            } else {
+                execute_one_pattern(r);
+                if (in_place)
+                    fj_model.calibrate_in_place(fj_est, timer::get_usec() - start_time);
+            }
 
             // co-run optimization
             if (r.corun_enabled && (r.pattern_step == r.corun_step))
@@ -1504,19 +2617,22 @@ out:
 
             if (need_fork_join(r)) {
                 vector<SPARQLQuery> sub_reqs = generate_sub_query(r);
-                rmap.put_parent_request(r, sub_reqs.size());
+                // only the fork-join of the last pattern calibrates the model (see calibrate_fork)
+                bool single_step = (r.pattern_step + 1 == r.pattern_group.patterns.size())
+                                   && r.final_rows();
+                put_parent_request(r, sub_reqs.size(),
+                                   (fj_est.valid && single_step) ? fj_est.max_dst_rows : 0);
                 for (int i = 0; i < sub_reqs.size(); i++) {
                     if (i != sid) {
                         Bundle bundle(sub_reqs[i]);
                         send_request(bundle, i, tid);
                     } else {
-                        pthread_spin_lock(&recv_lock);
-                        msg_fast_path.push_back(sub_reqs[i]);
-                        pthread_spin_unlock(&recv_lock);
+                        msg_fast_path.push(std::move(sub_reqs[i]));
                     }
                 }
                 return false;
             }
+            in_place = fj_est.valid;
         } while (true);
     }
 
@@ -1526,13 +2642,21 @@ out:
 
         if (r.state == SPARQLQuery::SQState::SQ_REPLY) {
             pthread_spin_lock(&engine->rmap_lock);
-            engine->rmap.put_reply(r);
+            if (!engine->rmap.put_reply(r)) {
+                pthread_spin_unlock(&engine->rmap_lock);
+                return; // discarded (the rows are enough for LIMIT)
+            }
 
             if (!engine->rmap.is_ready(r.pid)) {
                 pthread_spin_unlock(&engine->rmap_lock);
                 return; // not ready (waiting for the rest)
             }
 
+            // calibrate the cost of fork-join (see need_fork_join)
+            uint64_t fork_rows, fork_us;
+            if (engine->rmap.get_fork_stat(r.pid, fork_rows, fork_us))
+                engine->fj_model.calibrate_fork(fork_rows, fork_us);
+
             // all sub-queries have done, continue to execute
             r = engine->rmap.get_merged_reply(r.pid);
             pthread_spin_unlock(&engine->rmap_lock);
@@ -1549,7 +2673,7 @@ out:
             r.state = SPARQLQuery::SQState::SQ_UNION;
             int size = r.pattern_group.unions.size();
             r.union_done = true;
-            engine->rmap.put_parent_request(r, size);
+            put_parent_request(r, size);
             for (int i = 0; i < size; i++) {
                 SPARQLQuery union_req;
                 union_req.inherit_union(r, i);
@@ -1559,9 +2683,7 @@ out:
                     Bundle bundle(union_req);
                     send_request(bundle, dst_sid, tid);
                 } else {
-                    pthread_spin_lock(&recv_lock);
-                    msg_fast_path.push_back(union_req);
-                    pthread_spin_unlock(&recv_lock);
+                    msg_fast_path.push(std::move(union_req));
                 }
             }
             return;
@@ -1576,28 +2698,24 @@ out:
             if (need_fork_join(optional_req)) {
                 optional_req.id = r.id;
                 vector<SPARQLQuery> sub_reqs = generate_sub_query(optional_req);
-                rmap.put_parent_request(r, sub_reqs.size());
+                put_parent_request(r, sub_reqs.size());
                 for (int i = 0; i < sub_reqs.size(); i++) {
                     if (i != sid) {
                         Bundle bundle(sub_reqs[i]);
                         send_request(bundle, i, tid);
                     } else {
-                        pthread_spin_lock(&recv_lock);
-                        msg_fast_path.push_back(sub_reqs[i]);
-                        pthread_spin_unlock(&recv_lock);
+                        msg_fast_path.push(std::move(sub_reqs[i]));
                     }
                 }
             } else {
-                engine->rmap.put_parent_request(r, 1);
+                put_parent_request(r, 1);
                 int dst_sid = mymath::hash_mod(optional_req.pattern_group.get_start(),
                                                global_num_servers);
                 if (dst_sid != sid) {
                     Bundle bundle(optional_req);
                     send_request(bundle, dst_sid, tid);
                 } else {
-                    pthread_spin_lock(&recv_lock);
-                    msg_fast_path.push_back(optional_req);
-                    pthread_spin_unlock(&recv_lock);
+                    msg_fast_path.push(std::move(optional_req));
                 }
             }
             return;
@@ -1609,19 +2727,94 @@ out:
             filter(r);
         }
 
-        // 5. Final
+        // 5. Aggregate (partially on sub-queries)
+        if (r.has_aggregate() && !r.result.blind) {
+            if (QUERY_FROM_PROXY(coder.tid_of(r.pid)))
+                aggregate(r, true);
+            else if (r.pg_type == SPARQLQuery::PGType::BASIC && r.final_rows())
+                aggregate(r, false);
+        }
+
+        // 6. Final
         if (QUERY_FROM_PROXY(coder.tid_of(r.pid))) {
             r.state = SPARQLQuery::SQState::SQ_FINAL;
             final_process(r);
         }
 
-        // 6. Reply
+        // 7. Reply
         r.shrink_query();
         r.state = SPARQLQuery::SQState::SQ_REPLY;
+        if (need_streaming(r)) {
+            stream_reply(r);
+            return;
+        }
         Bundle bundle(r);
         send_request(bundle, coder.sid_of(r.pid), coder.tid_of(r.pid));
     }
 
+    // Whether to stream the (large) final result to the proxy in chunks
+    bool need_streaming(SPARQLQuery &r) {
+        return (global_stream_rows > 0
+                && QUERY_FROM_PROXY(coder.tid_of(r.pid))
+                && !r.result.blind
+                && r.result.get_row_num() > global_stream_rows);
+    }
+
+    // Send the final result to the proxy in chunks of (global_stream_rows) rows, so that
+    // no message is limited by the size of buffers. The proxy assembles them incrementally.
+    // NOTE: the chunks not sent yet (e.g., the proxy does not consume them in time) are kept
+    //       by the engine and sent in order by sweep_msgs, instead of waiting for the proxy.
+    void stream_reply(SPARQLQuery &r) {
+        Stream st;
+        st.sid = coder.sid_of(r.pid);
+        st.tid = coder.tid_of(r.pid);
+        st.chunk_rows = global_stream_rows;
+        st.nrows = r.result.get_row_num();
+        st.table.swap(r.result.result_table);
+        st.attr_table.swap(r.result.attr_res_table);
+        r.result.optional_matched_rows.clear();
+
+        st.reply = std::move(r);
+        st.reply.chunk_id = -1; // no chunk is built
+        st.reply.nchunks = (st.nrows + st.chunk_rows - 1) / st.chunk_rows;
+
+        if (!send_chunks(st))
+            pending_streams.push_back(std::move(st));
+    }
+
+    // Send the chunks of a streamed reply in order till the proxy is busy.
+    // Return true if all chunks have been sent.
+    bool send_chunks(Stream &st) {
+        SPARQLQuery &r = st.reply;
+        SPARQLQuery::Result &res = r.result;
+        int col_num = res.get_col_num();
+        int attr_col_num = res.get_attr_col_num();
+
+        while (true) {
+            // build the next chunk
+            if (!st.built) {
+                if (r.chunk_id + 1 == r.nchunks)
+                    return true;
+
+                r.chunk_id++;
+                int first = r.chunk_id * st.chunk_rows;
+                int last = min(st.nrows, first + st.chunk_rows);
+                res.row_num = last - first;
+                res.result_table.assign(st.table.begin() + first * col_num,
+                                        st.table.begin() + last * col_num);
+                if (attr_col_num > 0)
+                    res.attr_res_table.assign(st.attr_table.begin() + first * attr_col_num,
+                                              st.attr_table.begin() + last * attr_col_num);
+                st.chunk = Bundle(r);
+                st.built = true;
+            }
+
+            if (!adaptor->send(st.sid, st.tid, st.chunk))
+                return false;
+            st.built = false;
+        }
+    }
+
 #ifdef DYNAMIC_GSTORE
     void execute_load_data(RDFLoad & r) {
         // unbind the core from the thread in order to use openmpi to run multithreads
@@ -1660,8 +2853,73 @@ out:
         }
     }
 
+    // the statistics of work stealing (by this engine)
+    struct {
+        uint64_t bundles = 0; // unstarted bundles from other engines' adaptors
+        uint64_t queries = 0; // queued queries from other engines' runqueues
+        uint64_t morsels = 0; // morsels of other engines' queries
+        uint64_t reported = 0; // #tasks in last report
+        uint64_t last_report = 0;
+    } steal_stats;
+
+    unsigned int steal_seed;
+
+    // Try to steal a task from other busy (not self-sufficient) engines of the server.
+    // The victims are visited in a ring from a random one, and for each victim, a queued
+    // query is preferred over an unstarted bundle.
+    // NOTE: the large pattern of a query is split into morsels (see execute_morsels),
+    //       which are shared by all engines of the server.
+    bool steal_work() {
+        int own_id = tid - global_num_proxies;
+        int first = rand_r(&steal_seed) % global_num_engines;
+        for (int i = 0; i < global_num_engines; i++) {
+            int vid = (first + i) % global_num_engines;
+            Engine *victim = engines[vid];
+            if (vid == own_id
+                    || !victim->at_work // snooze
+                    || (timer::get_usec() - victim->last_time) < TIMEOUT_THRESHOLD)
+                continue;
+
+            SPARQLQuery req;
+            if (victim->runqueue.steal(req)) {
+                at_work = true;
+                last_time = timer::get_usec();
+                steal_stats.queries++;
+                execute_sparql_query(req, victim);
+                return true;
+            }
+
+            Bundle bundle;
+            if (victim->adaptor->tryrecv(bundle)) {
+                at_work = true;
+                last_time = timer::get_usec();
+                steal_stats.bundles++;
+                execute(bundle, victim);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void report_steal_stats() {
+        steal_stats.last_report = timer::get_usec();
+
+        uint64_t total = steal_stats.queries + steal_stats.bundles + steal_stats.morsels;
+        if (total == steal_stats.reported)
+            return; // nothing new
+        steal_stats.reported = total;
+
+        logstream(LOG_INFO) << "#" << tid << " stole "
+                            << steal_stats.queries << " queries, "
+                            << steal_stats.bundles << " bundles and "
+                            << steal_stats.morsels << " morsels from other engines." << LOG_endl;
+    }
+
 public:
     const static uint64_t TIMEOUT_THRESHOLD = 10000; // 10 msec
+    const static uint64_t STEAL_REPORT_INTERVAL = 10000000; // 10 sec
+    const static int RECV_BATCH = 32; // max #messages received per round
+    const static int LIMIT_SLICE_ROWS = 1024; // min #rows of the first slice for LIMIT
 
     int sid;    // server id
     int tid;    // thread id
@@ -1678,7 +2936,7 @@ public:
     Engine(int sid, int tid, String_Server * str_server, DGraph * graph, Adaptor * adaptor)
         : sid(sid), tid(tid), str_server(str_server), graph(graph), adaptor(adaptor),
           coder(sid, tid), last_time(timer::get_usec()) {
-        pthread_spin_init(&recv_lock, 0);
+        steal_seed = sid * global_num_threads + tid;
         pthread_spin_init(&rmap_lock, 0);
     }
 
@@ -1686,8 +2944,6 @@ public:
         // NOTE: the 'tid' of engine is not start from 0,
         // which can not be used by engines[] directly
         int own_id = tid - global_num_proxies;
-        // TODO: replace pair to ring
-        int nbr_id = (global_num_engines - 1) - own_id;
 
         uint64_t snooze_interval = MIN_SNOOZE_TIME;
 
@@ -1706,34 +2962,19 @@ public:
 
             // fast path (priority)
             SPARQLQuery request; // FIXME: only sparql query use fast-path now
-            pthread_spin_lock(&recv_lock);
-            if (msg_fast_path.size() > 0) {
-                request = msg_fast_path[0];
-                msg_fast_path.erase(msg_fast_path.begin());
-                at_work = true;
-            }
-            pthread_spin_unlock(&recv_lock);
-
-            if (at_work) {
+            if (msg_fast_path.pop(request)) {
                 reset_snooze(at_work, last_time);
                 execute_sparql_query(request, engines[own_id]);
                 continue; // exhaust all queries
             }
 
             // normal path: own runqueue
+            // NOTE: receive a bounded number of messages at a time, so that a burst of
+            //       new queries does not delay the in-flight ones
             Bundle bundle;
-            while (adaptor->tryrecv(bundle)) {
+            for (int i = 0; i < RECV_BATCH && adaptor->tryrecv(bundle); i++) {
                 if (bundle.type == SPARQL_QUERY) {
-                    // to be fair, engine will handle sub-queries priority
-                    // instead of processing a new query.
-                    SPARQLQuery req = bundle.get_sparql_query();
-                    if (req.priority != 0) {
-                        reset_snooze(at_work, last_time);
-                        execute_sparql_query(req, engines[own_id]);
-                        break;
-                    }
-
-                    runqueue.push_back(req);
+                    runqueue.push(bundle.get_sparql_query());
                 } else {
                     // FIXME: Jump a queue!
                     reset_snooze(at_work, last_time);
@@ -1742,27 +2983,40 @@ public:
                 }
             }
 
-            if (!at_work && runqueue.size() > 0) {
-                // get new task
-                SPARQLQuery req = runqueue[0];
-                runqueue.erase(runqueue.begin());
-
+            // to be fair, engine will handle replies and sub-queries (in-flight queries)
+            // first, then morsels of heavy queries, and new queries at last.
+            if (!at_work && runqueue.pop(request, 1)) {
                 reset_snooze(at_work, last_time);
-                execute_sparql_query(req, engines[own_id]);
+                execute_sparql_query(request, engines[own_id]);
             }
 
-            // normal path: neighboring runqueue
-            if (global_enable_workstealing)  { // work-oblige is enabled
-                // if neighboring engine is not self-sufficient, try to steal a task
-                // FIXME: only steal a task from normal runqueue (not incl. runqueue)
-                if (engines[nbr_id]->at_work // not snooze
-                        && ((timer::get_usec() - engines[nbr_id]->last_time) >= TIMEOUT_THRESHOLD)
-                        && engines[nbr_id]->adaptor->tryrecv(bundle)) { // FIXME: reuse bundle
+            // morsels of heavy queries (from all engines of the server)
+            if (!at_work) {
+                Morsel *m = morsel_pool.pop();
+                if (m != NULL) {
                     reset_snooze(at_work, last_time);
-                    execute(bundle, engines[nbr_id]);
+                    execute_morsel(m);
+                    steal_stats.morsels++; // always from other engines (see execute_morsels)
                 }
             }
 
+            if (!at_work && runqueue.pop(request)) {
+                // get new task
+                reset_snooze(at_work, last_time);
+                execute_sparql_query(request, engines[own_id]);
+            }
+
+            // normal path: other engines' runqueues
+            if (global_enable_workstealing && !at_work) { // work-oblige is enabled
+                if (steal_work())
+                    reset_snooze(at_work, last_time);
+            }
+
+            // report the work stealing periodically
+            if (global_enable_workstealing
+                    && (timer::get_usec() - steal_stats.last_report) >= STEAL_REPORT_INTERVAL)
+                report_steal_stats();
+
             if (at_work) continue; // keep calm (no snooze)
 
             // busy polling a little while (BUSY_POLLING_THRESHOLD) before snooze
@@ -26,7 +26,11 @@
 #include <vector>
 #include <queue>
 #include <iostream>
+#include <fstream>
 #include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <boost/unordered_set.hpp>
 #include <tbb/concurrent_hash_map.h>
 #include <tbb/concurrent_unordered_set.h>
@@ -36,6 +40,8 @@
 #include "data_statistic.hpp"
 #include "type.hpp"
 #include "buddy_malloc.hpp"
+#include "edge_codec.hpp"
+#include "bloom_filter.hpp"
 
 #include "mymath.hpp"
 #include "timer.hpp"
@@ -44,6 +50,10 @@
 
 using namespace std;
 
+#if defined(COMPRESSED_EDGES) && defined(DYNAMIC_GSTORE)
+#error "compressed edges (COMPRESSED_EDGES) do not support dynamic gstore (DYNAMIC_GSTORE)"
+#endif
+
 enum { NBITS_DIR = 1 };
 enum { NBITS_IDX = 17 }; // equal to the size of t/pid
 enum { NBITS_VID = (64 - NBITS_IDX - NBITS_DIR) }; // 0: index vertex, ID: normal vertex
@@ -94,26 +104,56 @@ uint64_t vid : NBITS_VID; // vertex
     }
 };
 
+// 8-bit fingerprint of a key, taken from the high bits of its hash.
+// 0 is reserved to mark an empty slot.
+static inline uint8_t key_fp(uint64_t hash) {
+    uint8_t fp = hash >> 56;
+    return fp ? fp : 1;
+}
+
 // 64-bit internal pointer
 //   NBITS_SIZE: the max number of edges (edge_t) for a single vertex (256M)
 //   NBITS_PTR: the max number of edges (edge_t) for the entire gstore (16GB)
 //   NBITS_TYPE: the type of edge, used for attribute triple, sid(0), int(1), float(2), double(4)
+//   NOTE: w/ COMPRESSED_EDGES, the size is the stored size of (compressed) edges (see EdgeCodec)
+//   NOTE: w/ INLINE_EDGES, a single edge (sid) is stored in the upper half of the pointer
+//         (i.e., the upper 32 bits of off) instead of the entry region
 enum { NBITS_SIZE = 28 };
 enum { NBITS_PTR  = 34 };
 enum { NBITS_TYPE =  2 };
 
+// The edges of vertex w/ a single edge are inlined, which requires 32-bit ID (sid).
+// The dynamic gstore updates edges in place, so it does not inline edges.
+#if !defined(DTYPE_64BIT) && !defined(DYNAMIC_GSTORE)
+#define INLINE_EDGES
+#endif
+
 struct iptr_t {
+uint64_t type: NBITS_TYPE;
 uint64_t size: NBITS_SIZE;
 uint64_t off: NBITS_PTR;
-uint64_t type: NBITS_TYPE;
 
-    iptr_t(): size(0), off(0), type(0) { }
+    iptr_t(): type(0), size(0), off(0) { }
     // the default type is sid(type = 0)
-    iptr_t(uint64_t s, uint64_t o, uint64_t t = 0): size(s), off(o), type(t) {
+    iptr_t(uint64_t s, uint64_t o, uint64_t t = 0): type(t), size(s), off(o) {
         // no truncated
         ASSERT ((size == s) && (off == o) && (type == t));
     }
 
+#ifdef INLINE_EDGES
+    static const int INLINE_SHIFT = 32 - (NBITS_TYPE + NBITS_SIZE);
+
+    // a pointer w/ a single inlined edge
+    static iptr_t inlined(sid_t val) { return iptr_t(1, (uint64_t)val << INLINE_SHIFT); }
+
+    bool is_inlined() { return (type == 0) && (size == 1); }
+
+    // the address of the inlined edge, i.e., the upper half of the pointer (little-endian)
+    sid_t *inlined_val() { return (sid_t *)this + 1; }
+#else
+    bool is_inlined() { return false; }
+#endif
+
     bool operator == (const iptr_t &ptr) {
         if ((size == ptr.size) && (off == ptr.off) && (type == ptr.type))
             return true;
@@ -124,6 +164,7 @@ uint64_t type: NBITS_TYPE;
         return !(operator == (ptr));
     }
 };
+static_assert(sizeof(iptr_t) == sizeof(uint64_t), "iptr_t should be 64-bit");
 
 // 128-bit vertex (key)
 struct vertex_t {
@@ -141,18 +182,73 @@ struct edge_t {
     }
 };
 
+/**
+ * The edges (values) of each vertex are sorted in ascending order (see GStore),
+ * so the membership test can use binary and galloping search instead of a linear scan.
+ */
+static const uint64_t EDGE_LINEAR_SCAN = 16; // short lists are faster to scan linearly
+
+// Return the first position in edges[lo, sz) whose value is not less than val.
+static inline uint64_t edge_lower_bound(edge_t *edges, uint64_t lo, uint64_t sz, sid_t val) {
+    uint64_t hi = sz;
+    while (hi - lo > EDGE_LINEAR_SCAN) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (edges[mid].val < val)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    while (lo < hi && edges[lo].val < val)
+        lo++;
+    return lo;
+}
+
+// Same as edge_lower_bound, but expect the result to be close to lo (e.g., probing
+// increasing values one by one), so exponentially enlarge the range before bisection.
+static inline uint64_t edge_gallop(edge_t *edges, uint64_t lo, uint64_t sz, sid_t val) {
+    uint64_t step = 1;
+    while (lo + step < sz && edges[lo + step].val < val) {
+        lo += step;
+        step <<= 1;
+    }
+    return edge_lower_bound(edges, lo, std::min(lo + step + 1, sz), val);
+}
+
+static inline bool edge_exist(edge_t *edges, uint64_t sz, sid_t val) {
+    uint64_t pos = edge_lower_bound(edges, 0, sz, val);
+    return (pos < sz && edges[pos].val == val);
+}
+
+// The edges of a key returned by batched lookups (see GStore::get_edges_batch)
+struct edge_span_t {
+    edge_t *ptr;
+    uint64_t sz;
+
+    edge_span_t(): ptr(NULL), sz(0) { }
+
+    edge_span_t(edge_t *ptr, uint64_t sz): ptr(ptr), sz(sz) { }
+};
+
 /**
  * Map the Graph model (e.g., vertex, edge, index) to KVS model (e.g., key, value)
+ *
+ * NOTE: the edges (values) of every key are always kept in ascending order.
  */
 class GStore {
 private:
-    /// TODO: use more clever cache structure with lock-free implementation
     /* Cache remote vertex(location) of the given key, eleminating one RDMA read.
      * This only works when RDMA enabled.
+     *
+     * The cache is N-way set-associative and each set uses CLOCK replacement.
+     * Lookups never take a lock: every set is guarded by a sequence lock (seqlock),
+     * whose version is odd while a writer updates the set. A reader retries if
+     * the version is changed during its read.
      */
     class RDMA_Cache {
+        static const int NUM_WAYS = 8;  // the associativity of each set
+        static const int MAX_RETRIES = 64;  // give up (read remotely) if the set keeps changing
+
         struct Item {
-            pthread_spinlock_t lock;
             vertex_t v;
 
 #ifdef DYNAMIC_GSTORE
@@ -162,58 +258,183 @@ private:
              */
             uint64_t expire_time;
 #endif
+        };
+
+        struct Set {
+            volatile uint64_t version; // even: stable, odd: under update
+            uint8_t refs[NUM_WAYS];    // reference bits of CLOCK
+            uint8_t hand;              // hand of CLOCK
+            Item items[NUM_WAYS];
+        } __attribute__((aligned(64)));
+
+        // per-thread counters (avoid false sharing among engines)
+        struct Stat {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+        } __attribute__((aligned(64)));
+
+        Set *sets = NULL;
+        uint64_t num_sets = 0;
+        Stat *stats = NULL;
+        int num_stats = 0;
+
+        uint64_t lease = 0;   // term of cache item. Only work for cache coherence.
+
+        inline Set &get_set(ikey_t &key) { return sets[key.hash() % num_sets]; }
+
+        inline Stat &get_stat(int tid) {
+            ASSERT(tid >= 0 && tid < num_stats);
+            return stats[tid];
+        }
 
-            Item() {
-                pthread_spin_init(&lock, 0);
+        // acquire the writer side of seqlock (version becomes odd)
+        inline uint64_t write_lock(Set &set) {
+            uint64_t ver;
+            do {
+                ver = set.version & ~1ull;
+            } while (!__sync_bool_compare_and_swap(&set.version, ver, ver + 1));
+            return ver;
+        }
+
+        // release the writer side of seqlock (version becomes even)
+        inline void write_unlock(Set &set, uint64_t ver) {
+            __atomic_store_n(&set.version, ver + 2, __ATOMIC_RELEASE);
+        }
+
+        inline bool is_valid(Item &item, uint64_t now) {
+#ifdef DYNAMIC_GSTORE
+            return !item.v.key.is_empty() && (now < item.expire_time);
+#else
+            return !item.v.key.is_empty();
+#endif
+        }
+
+        // choose a victim by CLOCK (empty or expired slots first)
+        inline int choose_victim(Set &set, uint64_t now, bool &evicted) {
+            for (int i = 0; i < NUM_WAYS; i++) {
+                if (!is_valid(set.items[i], now)) {
+                    evicted = false;
+                    return i;
+                }
             }
-        };
 
-        static const int NUM_ITEMS = 100000;
-        Item items[NUM_ITEMS];
-        uint64_t lease;   // term of cache item. Only work for cache coherence.
+            while (set.refs[set.hand]) { // give a second chance
+                set.refs[set.hand] = 0;
+                set.hand = (set.hand + 1) % NUM_WAYS;
+            }
+            int victim = set.hand;
+            set.hand = (set.hand + 1) % NUM_WAYS;
+            evicted = true;
+            return victim;
+        }
 
     public:
-        RDMA_Cache() { }
-        RDMA_Cache(uint64_t lease): lease(lease) { }
+        RDMA_Cache() {
+            num_sets = max(1ul, (uint64_t)global_rdma_cache_entries / NUM_WAYS);
+            if (posix_memalign((void **)&sets, 64, num_sets * sizeof(Set)) != 0) {
+                logstream(LOG_ERROR) << "failed to allocate RDMA cache." << LOG_endl;
+                ASSERT(false);
+            }
+            memset((void *)sets, 0, num_sets * sizeof(Set));
+
+            num_stats = global_num_threads;
+            if (posix_memalign((void **)&stats, 64, num_stats * sizeof(Stat)) != 0) {
+                logstream(LOG_ERROR) << "failed to allocate RDMA cache." << LOG_endl;
+                ASSERT(false);
+            }
+            memset((void *)stats, 0, num_stats * sizeof(Stat));
+        }
+
+        ~RDMA_Cache() {
+            free(sets);
+            free(stats);
+        }
+
+        void set_lease(uint64_t l) { lease = l; }
+
+        uint64_t capacity() { return num_sets * NUM_WAYS; }
 
         /* Lookup a vertex in cache according to the given key.*/
-        bool lookup(ikey_t key, vertex_t &ret) {
+        bool lookup(int tid, ikey_t key, vertex_t &ret) {
             if (!global_enable_caching)
                 return false;
 
-            int idx = key.hash() % NUM_ITEMS;
-            bool found = false;
-            pthread_spin_lock(&(items[idx].lock));
-            if (items[idx].v.key == key) {
+            Set &set = get_set(key);
+            int way = -1;
+            int retries = 0;
+            while (true) {
+                if (retries++ == MAX_RETRIES) { // fall back to a remote read
+                    way = -1;
+                    break;
+                }
 
-#ifdef DYNAMIC_GSTORE
-                // check if timeout
-                if (timer::get_usec() < items[idx].expire_time) {
-                    ret = items[idx].v;
-                    found = true;
+                uint64_t ver = __atomic_load_n(&set.version, __ATOMIC_ACQUIRE);
+                if (ver & 1) { // a writer is updating the set
+                    _mm_pause();
+                    continue;
                 }
+
+                way = -1;
+                for (int i = 0; i < NUM_WAYS; i++) {
+                    if (set.items[i].v.key == key) {
+                        ret = set.items[i].v;
+#ifdef DYNAMIC_GSTORE
+                        // check if timeout
+                        if (timer::get_usec() < set.items[i].expire_time)
+                            way = i;
 #else
-                ret = items[idx].v;
-                found = true;
+                        way = i;
 #endif
+                        break;
+                    }
+                }
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (set.version == ver) break; // consistent snapshot
+                _mm_pause();
             }
-            pthread_spin_unlock(&(items[idx].lock));
-            return found;
+
+            Stat &stat = get_stat(tid);
+            if (way < 0) {
+                stat.misses++;
+                return false;
+            }
+
+            if (!set.refs[way]) set.refs[way] = 1; // only a hint for CLOCK
+            stat.hits++;
+            return true;
         }
 
         /* Insert a vertex into cache. */
-        void insert(vertex_t &v) {
+        void insert(int tid, vertex_t &v) {
             if (!global_enable_caching)
                 return;
-            int idx = v.key.hash() % NUM_ITEMS;
-            pthread_spin_lock(&items[idx].lock);
 
+            Set &set = get_set(v.key);
+            uint64_t now = timer::get_usec();
+            bool evicted = false;
+
+            uint64_t ver = write_lock(set);
+            int way = -1;
+            for (int i = 0; i < NUM_WAYS; i++) {
+                if (set.items[i].v.key == v.key) { // update in place
+                    way = i;
+                    break;
+                }
+            }
+            if (way < 0)
+                way = choose_victim(set, now, evicted);
+
+            set.items[way].v = v;
 #ifdef DYNAMIC_GSTORE
             // set expire time of cache item
-            items[idx].expire_time = timer::get_usec() + lease;
+            set.items[way].expire_time = now + lease;
 #endif
-            items[idx].v = v;
-            pthread_spin_unlock(&items[idx].lock);
+            set.refs[way] = 1;
+            write_unlock(set, ver);
+
+            if (evicted) get_stat(tid).evictions++;
         }
 
         /* Invalidate cache item of the given key.
@@ -223,17 +444,48 @@ private:
             if (!global_enable_caching)
                 return;
 
-            int idx = key.hash() % NUM_ITEMS;
-            pthread_spin_lock(&(items[idx].lock));
-            if (items[idx].v.key == key)
-                items[idx].v.key = ikey_t();
-            pthread_spin_unlock(&items[idx].lock);
+            Set &set = get_set(key);
+            uint64_t ver = write_lock(set);
+            for (int i = 0; i < NUM_WAYS; i++) {
+                if (set.items[i].v.key == key) {
+                    set.items[i].v.key = ikey_t();
+                    set.refs[i] = 0;
+                }
+            }
+            write_unlock(set, ver);
+        }
+
+        void get_stats(uint64_t &hits, uint64_t &misses, uint64_t &evictions) {
+            hits = misses = evictions = 0;
+            for (int i = 0; i < num_stats; i++) {
+                hits += stats[i].hits;
+                misses += stats[i].misses;
+                evictions += stats[i].evictions;
+            }
+        }
+
+        void get_stats(int tid, uint64_t &hits, uint64_t &misses) {
+            Stat &stat = get_stat(tid);
+            hits = stat.hits;
+            misses = stat.misses;
+        }
+
+        void print_stats() {
+            uint64_t hits, misses, evictions;
+            get_stats(hits, misses, evictions);
+            logstream(LOG_INFO) << "rdma cache: " << capacity() << " entries ("
+                                << num_sets << " sets x " << NUM_WAYS << " ways)" << LOG_endl;
+            logstream(LOG_INFO) << "\thit: " << hits << ", miss: " << misses
+                                << ", eviction: " << evictions << " ("
+                                << ((hits + misses) ? 100.0 * hits / (hits + misses) : 0.0)
+                                << " % hit ratio)" << LOG_endl;
         }
     };
 
     static const int NUM_LOCKS = 1024;
 
     static const int ASSOCIATIVITY = 8;  // the associativity of slots in each bucket
+    static_assert(ASSOCIATIVITY - 1 <= sizeof(iptr_t), "fingerprints should fit in the ptr of a slot");
 
     // Memory Usage (estimation):
     //   header region: |vertex| = 128-bit; #verts = (#S + #O) * AVG(#P) ～= #T
@@ -260,67 +512,165 @@ private:
     uint64_t last_ext;
     pthread_spinlock_t bucket_ext_lock;
 
+#ifdef DYNAMIC_GSTORE
+    /// The indirect-header region grows online by borrowing chunks of buckets from the entry
+    /// region (via edge_allocator) when it runs out. The entry region follows the header region,
+    /// so a borrowed (aligned) bucket is still identified by its bucket_id (i.e., its offset
+    /// in kvstore), and the chaining and RDMA reads of buckets remain unchanged.
+    static const uint64_t EXT_CHUNK_BUCKETS = 4096;
+
+    // the borrowed chunks of buckets [first, last), the last chunk is being used
+    vector<pair<uint64_t, uint64_t>> ext_chunks;
+    uint64_t num_borrowed_ext = 0;
+
+    // Borrow a new indirect header from the entry region (with bucket_ext_lock held).
+    uint64_t borrow_bucket_ext() {
+        uint64_t bucket_sz = ASSOCIATIVITY * sizeof(vertex_t);
+        if (ext_chunks.empty()
+                || ext_chunks.back().second - ext_chunks.back().first == EXT_CHUNK_BUCKETS) {
+            // align the chunk to the bucket size
+            uint64_t off = edge_allocator->malloc((EXT_CHUNK_BUCKETS + 1) * bucket_sz);
+            uint64_t first = (num_slots * sizeof(vertex_t) + off + bucket_sz - 1) / bucket_sz;
+            memset((void *)&vertices[first * ASSOCIATIVITY], 0, EXT_CHUNK_BUCKETS * bucket_sz);
+            ext_chunks.push_back(make_pair(first, first));
+
+            logstream(LOG_INFO) << "#" << sid << ": borrow " << EXT_CHUNK_BUCKETS
+                                << " indirect headers from the entry region." << LOG_endl;
+        }
+
+        num_borrowed_ext++;
+        return ext_chunks.back().second++;
+    }
+#endif
+
+    // Return the ranges of used buckets [first, last) in header region (and borrowed ones).
+    vector<pair<uint64_t, uint64_t>> bucket_ranges() {
+        vector<pair<uint64_t, uint64_t>> ranges;
+        ranges.push_back(make_pair(0, num_buckets + last_ext));
+#ifdef DYNAMIC_GSTORE
+        pthread_spin_lock(&bucket_ext_lock);
+        ranges.insert(ranges.end(), ext_chunks.begin(), ext_chunks.end());
+        pthread_spin_unlock(&bucket_ext_lock);
+#endif
+        return ranges;
+    }
 
 
+
+    /// The last slot of each bucket is always reserved for the pointer to indirect header.
+    /// Its key.vid stores the bucket_id of next bucket, and its (otherwise unused) ptr stores
+    /// the 8-bit fingerprints of the other (ASSOCIATIVITY - 1) slots. A single SIMD compare
+    /// on the fingerprints finds the candidate slots, and only candidates compare full keys.
+    /// The fingerprints stay within the bucket, so one RDMA read of a remote bucket brings them too.
+    static inline uint8_t *bucket_fps(vertex_t *bucket) {
+        return (uint8_t *)&(bucket[ASSOCIATIVITY - 1].ptr);
+    }
+
+    // Return a bitmap of the slots whose fingerprint is fp (fp = 0: empty slots).
+    static inline uint32_t match_fps(vertex_t *bucket, uint8_t fp) {
+        uint64_t fps;
+        memcpy(&fps, bucket_fps(bucket), sizeof(uint64_t));
+#ifdef __SSE2__
+        __m128i eq = _mm_cmpeq_epi8(_mm_cvtsi64_si128(fps), _mm_set1_epi8(fp));
+        return _mm_movemask_epi8(eq) & ((1u << (ASSOCIATIVITY - 1)) - 1);
+#else
+        // SWAR: find the zero bytes of (fps ^ fp), false positives are filtered by key compare
+        uint64_t x = fps ^ (0x0101010101010101ull * fp);
+        uint64_t z = (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+        uint32_t bitmap = 0;
+        for (int i = 0; i < ASSOCIATIVITY - 1; i++)
+            bitmap |= ((z >> (i * 8 + 7)) & 1) << i;
+        return bitmap;
+#endif
+    }
+
+    // Return the slot (in the bucket) of given key, or -1 if not found.
+    static inline int probe_bucket(vertex_t *bucket, ikey_t &key, uint8_t fp) {
+        uint32_t cands = match_fps(bucket, fp);
+        while (cands) {
+            int i = __builtin_ctz(cands);
+            if (bucket[i].key == key)
+                return i;
+            cands &= cands - 1; // false positive of fingerprint
+        }
+        return -1;
+    }
+
+    // Set the key of an empty slot and publish its fingerprint (after the key).
+    static inline void fill_slot(vertex_t *bucket, int i, ikey_t &key, uint8_t fp) {
+        bucket[i].key = key;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        bucket_fps(bucket)[i] = fp;
+    }
+
     // cluster chaining hash-table (see paper: DrTM SOSP'15)
     uint64_t insert_key(ikey_t key, bool check_dup = true) {
-        uint64_t bucket_id = key.hash() % num_buckets;
-        uint64_t slot_id = bucket_id * ASSOCIATIVITY;
+        uint64_t hash = key.hash();
+        uint8_t fp = key_fp(hash);
+        uint64_t bucket_id = hash % num_buckets;
         uint64_t lock_id = bucket_id % NUM_LOCKS;
+        uint64_t slot_id = bucket_id * ASSOCIATIVITY;
 
-        bool found = false;
         pthread_spin_lock(&bucket_locks[lock_id]);
-        while (slot_id < num_slots) {
-            // the last slot of each bucket is always reserved for pointer to indirect header
-            /// TODO: add type info to slot and reuse the last slot to store key
-            /// TODO: key.vid is reused to store the bucket_id of indirect header rather than ptr.off,
-            ///       since the is_empty() is not robust.
-            for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
-                //ASSERT(vertices[slot_id].key != key); // no duplicate key
-                if (vertices[slot_id].key == key) {
-                    if (check_dup) {
-                        key.print_key();
-                        vertices[slot_id].key.print_key();
-                        logstream(LOG_ERROR) << "conflict at slot["
-                                             << slot_id << "] of bucket["
-                                             << bucket_id << "]" << LOG_endl;
-                        ASSERT(false);
-                    } else {
-                        goto done;
-                    }
+        while (true) {
+            vertex_t *bucket = &vertices[bucket_id * ASSOCIATIVITY];
+
+            int i = probe_bucket(bucket, key, fp);
+            if (i >= 0) {
+                slot_id = bucket_id * ASSOCIATIVITY + i;
+                if (check_dup) {
+                    key.print_key();
+                    vertices[slot_id].key.print_key();
+                    logstream(LOG_ERROR) << "conflict at slot["
+                                         << slot_id << "] of bucket["
+                                         << bucket_id << "]" << LOG_endl;
+                    ASSERT(false);
                 }
+                goto done;
+            }
 
-                // insert to an empty slot
-                if (vertices[slot_id].key.is_empty()) {
-                    vertices[slot_id].key = key;
-                    goto done;
-                }
+            // insert to an empty slot
+            uint32_t empty = match_fps(bucket, 0);
+            if (empty) {
+                i = __builtin_ctz(empty);
+                fill_slot(bucket, i, key, fp);
+                slot_id = bucket_id * ASSOCIATIVITY + i;
+                goto done;
             }
 
             // whether the bucket_ext (indirect-header region) is used
-            if (!vertices[slot_id].key.is_empty()) {
-                slot_id = vertices[slot_id].key.vid * ASSOCIATIVITY;
+            if (!bucket[ASSOCIATIVITY - 1].key.is_empty()) {
+                bucket_id = bucket[ASSOCIATIVITY - 1].key.vid;
+                slot_id = bucket_id * ASSOCIATIVITY;
                 continue; // continue and jump to next bucket
             }
 
-
             // allocate and link a new indirect header
             pthread_spin_lock(&bucket_ext_lock);
             if (last_ext >= num_buckets_ext) {
+#ifdef DYNAMIC_GSTORE
+                bucket_id = borrow_bucket_ext();
+#else
                 logstream(LOG_ERROR) << "out of indirect-header region." << LOG_endl;
                 ASSERT(last_ext < num_buckets_ext);
+#endif
+            } else {
+                bucket_id = num_buckets + (last_ext++);
             }
-            vertices[slot_id].key.vid = num_buckets + (last_ext++);
             pthread_spin_unlock(&bucket_ext_lock);
 
-            slot_id = vertices[slot_id].key.vid * ASSOCIATIVITY; // move to a new bucket_ext
-            vertices[slot_id].key = key; // insert to the first slot
+            // insert to the first slot of the new bucket_ext before linking it
+            fill_slot(&vertices[bucket_id * ASSOCIATIVITY], 0, key, fp);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            bucket[ASSOCIATIVITY - 1].key.vid = bucket_id;
+
+            slot_id = bucket_id * ASSOCIATIVITY;
             goto done;
         }
 done:
         pthread_spin_unlock(&bucket_locks[lock_id]);
-        ASSERT(slot_id < num_slots);
         ASSERT(vertices[slot_id].key == key);
+        key_filters[sid].insert(hash); // keep the local filter complete (no-op if not built)
         return slot_id;
     }
 
@@ -405,45 +755,31 @@ done:
     }
 
     bool is_dup(vertex_t *v, uint64_t value) {
-        int size = v->ptr.size;
-        for (int i = 0; i < size; i++)
-            if (edges[v->ptr.off + i].val == value)
-                return true;
-        return false;
+        return edge_exist(&edges[v->ptr.off], v->ptr.size, value);
     }
 
     bool check_key_exist(ikey_t key) {
-        uint64_t bucket_id = key.hash() % num_buckets;
-        uint64_t slot_id = bucket_id * ASSOCIATIVITY;
+        uint64_t hash = key.hash();
+        uint8_t fp = key_fp(hash);
+        uint64_t bucket_id = hash % num_buckets;
         uint64_t lock_id = bucket_id % NUM_LOCKS;
+        bool found = false;
 
         pthread_spin_lock(&bucket_locks[lock_id]);
-        while (slot_id < num_slots) {
-            // the last slot of each bucket is always reserved for pointer to indirect header
-            /// TODO: add type info to slot and reuse the last slot to store key
-            /// TODO: key.vid is reused to store the bucket_id of indirect header rather than ptr.off,
-            ///       since the is_empty() is not robust.
-            for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
-                //ASSERT(vertices[slot_id].key != key); // no duplicate key
-                if (vertices[slot_id].key == key) {
-                    pthread_spin_unlock(&bucket_locks[lock_id]);
-                    return true;
-                }
-
-                // insert to an empty slot
-                if (vertices[slot_id].key.is_empty()) {
-                    pthread_spin_unlock(&bucket_locks[lock_id]);
-                    return false;
-                }
+        while (true) {
+            vertex_t *bucket = &vertices[bucket_id * ASSOCIATIVITY];
+            if (probe_bucket(bucket, key, fp) >= 0) {
+                found = true;
+                break;
             }
+
             // whether the bucket_ext (indirect-header region) is used
-            if (!vertices[slot_id].key.is_empty()) {
-                slot_id = vertices[slot_id].key.vid * ASSOCIATIVITY;
-                continue; // continue and jump to next bucket
-            }
-            pthread_spin_unlock(&bucket_locks[lock_id]);
-            return false;
+            if (bucket[ASSOCIATIVITY - 1].key.is_empty())
+                break;
+            bucket_id = bucket[ASSOCIATIVITY - 1].key.vid; // jump to next bucket
         }
+        pthread_spin_unlock(&bucket_locks[lock_id]);
+        return found;
     }
 
     bool insert_vertex_edge(ikey_t key, uint64_t value, bool &dedup_or_isdup) {
@@ -468,13 +804,19 @@ done:
             dedup_or_isdup = false;
             uint64_t need_size = v->ptr.size + 1;
 
+            // keep edges in order, the new value is usually appended to the end
+            uint64_t pos = edge_lower_bound(&edges[v->ptr.off], 0, v->ptr.size, value);
+
             // a new block is needed
-            if (blksz(v->ptr.size + 1) - 1 < need_size) {
+            // NOTE: edges are never moved in place, since concurrent readers do not hold the lock.
+            //       A value inserted in the middle also goes to a new block (copy-on-write).
+            if (blksz(v->ptr.size + 1) - 1 < need_size || pos < v->ptr.size) {
                 iptr_t old_ptr = v->ptr;
 
                 uint64_t off = alloc_edges(need_size);
-                memcpy(&edges[off], &edges[old_ptr.off], e2b(old_ptr.size));
-                edges[off + old_ptr.size].val = value;
+                memcpy(&edges[off], &edges[old_ptr.off], e2b(pos));
+                edges[off + pos].val = value;
+                memcpy(&edges[off + pos + 1], &edges[old_ptr.off + pos], e2b(old_ptr.size - pos));
                 // invalidate the old block
                 insert_sz(INVALID_EDGES, old_ptr.size, old_ptr.off);
                 v->ptr = iptr_t(need_size, off);
@@ -526,6 +868,61 @@ done:
     }
 #endif // DYNAMIC_GSTORE
 
+    // Store the (sorted) edges of the vertex at given slot.
+    void insert_edges(uint64_t slot_id, const sid_t *vals, uint64_t n, int64_t tid = -1) {
+#ifdef INLINE_EDGES
+        if (n == 1) {
+            vertices[slot_id].ptr = iptr_t::inlined(vals[0]);
+            return;
+        }
+#endif
+
+#ifdef COMPRESSED_EDGES
+        uint64_t sz = EdgeCodec::encoded_size(vals, n);
+        uint64_t off = alloc_edges(sz, tid);
+        EdgeCodec::encode(vals, n, (sid_t *)&edges[off], sz);
+#else
+        uint64_t sz = n;
+        uint64_t off = alloc_edges(sz, tid);
+        for (uint64_t i = 0; i < n; i++)
+            edges[off + i].val = vals[i];
+#endif
+        vertices[slot_id].ptr = iptr_t(sz, off);
+    }
+
+    vector<vector<sid_t>> edge_bufs; // per-thread buffer to decode compressed edges
+    vector<vector<sid_t>> batch_bufs; // per-thread buffer for the edges of batched lookups
+
+    // Return the edges stored for the (local) vertex, which should be a slot of the header region
+    // since the edges may be inlined.
+    inline edge_t *local_edges(vertex_t &v) {
+#ifdef INLINE_EDGES
+        if (v.ptr.is_inlined())
+            return (edge_t *)v.ptr.inlined_val();
+#endif
+        return &edges[v.ptr.off];
+    }
+
+    // Return the number of edges of the (local) vertex.
+    inline uint64_t count_edges(vertex_t &v) {
+#ifdef COMPRESSED_EDGES
+        return EdgeCodec::count((sid_t *)local_edges(v), v.ptr.size);
+#else
+        return v.ptr.size;
+#endif
+    }
+
+    // Return the edges (and its size) stored at edge_ptr (in local entry region or RDMA buffer).
+    // Compressed edges are decoded to @buf.
+    inline edge_t *decode_edges(edge_t *edge_ptr, iptr_t &ptr, uint64_t *sz, vector<sid_t> &buf) {
+#ifdef COMPRESSED_EDGES
+        return (edge_t *)EdgeCodec::decode((sid_t *)edge_ptr, ptr.size, sz, buf);
+#else
+        *sz = ptr.size;
+        return edge_ptr;
+#endif
+    }
+
     typedef tbb::concurrent_hash_map<sid_t, vector<sid_t>> tbb_hash_map;
 
     tbb_hash_map pidx_in_map; // predicate-index (IN)
@@ -533,18 +930,14 @@ done:
     tbb_hash_map tidx_map; // type-index
 
     void insert_index_map(tbb_hash_map &map, dir_t d) {
-        for (auto const &e : map) {
+        for (auto &e : map) {
             sid_t pid = e.first;
-            uint64_t sz = e.second.size();
-            uint64_t off = alloc_edges(sz);
+            // vids are collected in parallel, sort them to keep edges in order
+            sort(e.second.begin(), e.second.end());
 
             ikey_t key = ikey_t(0, pid, d);
             uint64_t slot_id = insert_key(key);
-            iptr_t ptr = iptr_t(sz, off);
-            vertices[slot_id].ptr = ptr;
-
-            for (auto const &vid : e.second)
-                edges[off++].val = vid;
+            insert_edges(slot_id, e.second.data(), e.second.size());
         }
     }
 
@@ -556,36 +949,48 @@ done:
     tbb_unordered_set p_set; // all of predicates
 
     void insert_index_set(tbb_unordered_set &set, sid_t tpid, dir_t d) {
-        uint64_t sz = set.size();
-        uint64_t off = alloc_edges(sz);
-
         ikey_t key = ikey_t(0, tpid, d);
         uint64_t slot_id = insert_key(key);
-        iptr_t ptr = iptr_t(sz, off);
-        vertices[slot_id].ptr = ptr;
 
-        for (auto const &e : set)
-            edges[off++].val = e;
+        // the unordered set has no order, sort it to keep edges in order
+        vector<sid_t> vids(set.begin(), set.end());
+        sort(vids.begin(), vids.end());
+        insert_edges(slot_id, vids.data(), vids.size());
     }
 #endif // VERSATILE
 
 
     RDMA_Cache rdma_cache;
 
-    // Get edges of given vertex from dst_sid by RDMA read.
-    inline edge_t *rdma_get_edges(int tid, int dst_sid, vertex_t &v) {
-        ASSERT(global_use_rdma);
+    /// Bloom filters over the keys of all servers (the local one and the replicas of others),
+    /// which are used to skip the RDMA reads of buckets for missing keys (e.g., OPTIONAL).
+    /// The replicas are built and synchronized after loading (see DGraph).
+    vector<Bloom_Filter> key_filters;
+    bool key_filters_synced = false; // whether the replicas of other servers are up-to-date
 
-        char *buf = mem->buffer(tid);
-        uint64_t r_off  = num_slots * sizeof(vertex_t) + v.ptr.off * sizeof(edge_t);
+    // The offset (in kvstore) of edges of given vertex.
+    inline uint64_t rdma_edges_off(vertex_t &v) {
+        return num_slots * sizeof(vertex_t) + v.ptr.off * sizeof(edge_t);
+    }
 
+    // The size of RDMA read to fetch the edges of given vertex.
+    inline uint64_t rdma_edges_size(vertex_t &v) {
 #ifdef DYNAMIC_GSTORE
         // the size of entire blk
-        uint64_t r_sz = blksz(v.ptr.size + 1) * sizeof(edge_t);
+        return blksz(v.ptr.size + 1) * sizeof(edge_t);
 #else
         // the size of edges
-        uint64_t r_sz = v.ptr.size * sizeof(edge_t);
+        return v.ptr.size * sizeof(edge_t);
 #endif
+    }
+
+    // Get edges of given vertex from dst_sid by RDMA read.
+    inline edge_t *rdma_get_edges(int tid, int dst_sid, vertex_t &v) {
+        ASSERT(global_use_rdma);
+
+        char *buf = mem->buffer(tid);
+        uint64_t r_off = rdma_edges_off(v);
+        uint64_t r_sz = rdma_edges_size(v);
 
         uint64_t buf_sz = mem->buffer_size();
         ASSERT(r_sz < buf_sz); // enough space to host the edges
@@ -598,20 +1003,26 @@ done:
     // Get remote vertex of given key. This func will fail if RDMA is disabled.
     vertex_t get_vertex_remote(int tid, ikey_t key) {
         int dst_sid = mymath::hash_mod(key.vid, global_num_servers);
-        uint64_t bucket_id = key.hash() % num_buckets;
+        uint64_t hash = key.hash();
+        uint64_t bucket_id = hash % num_buckets;
         vertex_t vert;
 
         // Currently, we don't support to directly get remote vertex/edge without RDMA
         // TODO: implement it w/o RDMA
         ASSERT(global_use_rdma);
 
+        // skip the key definitely missing on the remote server
+        if (key_filters_synced && !key_filters[dst_sid].may_contain(hash))
+            return vertex_t();
+
         // check cache
-        if (rdma_cache.lookup(key, vert))
+        if (rdma_cache.lookup(tid, key, vert))
             return vert;
 
         // get vertex by RDMA
         char *buf = mem->buffer(tid);
         uint64_t buf_sz = mem->buffer_size();
+        uint8_t fp = key_fp(hash);
         while (true) {
             uint64_t off = bucket_id * ASSOCIATIVITY * sizeof(vertex_t);
             uint64_t sz = ASSOCIATIVITY * sizeof(vertex_t);
@@ -620,35 +1031,110 @@ done:
             RDMA &rdma = RDMA::get_rdma();
             rdma.dev->RdmaRead(tid, dst_sid, buf, sz, off);
             vertex_t *verts = (vertex_t *)buf;
-            for (int i = 0; i < ASSOCIATIVITY; i++) {
-                if (i < ASSOCIATIVITY - 1) {
-                    if (verts[i].key == key) {
-                        rdma_cache.insert(verts[i]);
-                        return verts[i]; // found
-                    }
-                } else {
-                    if (verts[i].key.is_empty())
-                        return vertex_t(); // not found
 
-                    bucket_id = verts[i].key.vid; // move to next bucket
-                    break; // break for-loop
-                }
+            int i = probe_bucket(verts, key, fp);
+            if (i >= 0) {
+                rdma_cache.insert(tid, verts[i]);
+                return verts[i]; // found
             }
+
+            if (verts[ASSOCIATIVITY - 1].key.is_empty())
+                return vertex_t(); // not found
+
+            bucket_id = verts[ASSOCIATIVITY - 1].key.vid; // move to next bucket
         }
     } // end of get_vertex_remote
 
+    // Get remote vertices of given keys (@keys[@ids]) to @verts by batched RDMA reads.
+    // The buckets of each round are read to @buf, which should host (#ids) buckets.
+    void get_vertices_remote_batch(int tid, const vector<ikey_t> &keys, const vector<uint64_t> &ids,
+                                   vertex_t *verts, char *buf) {
+        ASSERT(global_use_rdma);
+
+        uint64_t bucket_sz = ASSOCIATIVITY * sizeof(vertex_t);
+        vector<uint64_t> pending;
+        vector<uint64_t> bucket_ids(ids.size());
+        for (uint64_t j = 0; j < ids.size(); j++) {
+            ikey_t key = keys[ids[j]];
+            int dst_sid = mymath::hash_mod(key.vid, global_num_servers);
+            uint64_t hash = key.hash();
+
+            verts[j] = vertex_t();
+            if (key_filters_synced && !key_filters[dst_sid].may_contain(hash))
+                continue; // definitely missing
+            if (rdma_cache.lookup(tid, key, verts[j]))
+                continue;
+
+            bucket_ids[j] = hash % num_buckets;
+            pending.push_back(j);
+        }
+
+        // follow the chains of buckets of all keys round by round
+        RDMA &rdma = RDMA::get_rdma();
+        vector<rdma_read_req_t> reqs;
+        while (!pending.empty()) {
+            reqs.clear();
+            for (uint64_t k = 0; k < pending.size(); k++) {
+                uint64_t j = pending[k];
+                int dst_sid = mymath::hash_mod(keys[ids[j]].vid, global_num_servers);
+                reqs.push_back(rdma_read_req_t(dst_sid, buf + k * bucket_sz, bucket_sz,
+                                               bucket_ids[j] * bucket_sz));
+            }
+            rdma.dev->RdmaReadBatch(tid, reqs);
+
+            vector<uint64_t> next;
+            for (uint64_t k = 0; k < pending.size(); k++) {
+                uint64_t j = pending[k];
+                ikey_t key = keys[ids[j]];
+                vertex_t *bucket = (vertex_t *)(buf + k * bucket_sz);
+
+                int i = probe_bucket(bucket, key, key_fp(key.hash()));
+                if (i >= 0) {
+                    verts[j] = bucket[i]; // found
+                    rdma_cache.insert(tid, bucket[i]);
+                } else if (!bucket[ASSOCIATIVITY - 1].key.is_empty()) {
+                    bucket_ids[j] = bucket[ASSOCIATIVITY - 1].key.vid; // move to next bucket
+                    next.push_back(j);
+                } // otherwise, not found
+            }
+            pending.swap(next);
+        }
+    }
+
+    // Get the slot of given key in local header region (NULL if not found).
+    vertex_t *find_vertex_local(ikey_t key) {
+        uint64_t hash = key.hash();
+        uint8_t fp = key_fp(hash);
+        uint64_t bucket_id = hash % num_buckets;
+        while (true) {
+            vertex_t *bucket = &vertices[bucket_id * ASSOCIATIVITY];
+            int i = probe_bucket(bucket, key, fp);
+            if (i >= 0)
+                return &bucket[i]; // found
+
+            if (bucket[ASSOCIATIVITY - 1].key.is_empty())
+                return NULL; // not found
+
+            bucket_id = bucket[ASSOCIATIVITY - 1].key.vid; // move to next bucket
+        }
+    }
+
     // Get local vertex of given key.
     vertex_t get_vertex_local(int tid, ikey_t key) {
+        vertex_t *v = find_vertex_local(key);
+        return (v != NULL) ? *v : vertex_t();
+    }
+
+    // Get local vertex of given key by comparing all slots one by one (w/o fingerprints).
+    // It is only used to measure the benefit of fingerprints (see print_probe_latency).
+    vertex_t get_vertex_local_noprobe(int tid, ikey_t key) {
         uint64_t bucket_id = key.hash() % num_buckets;
         while (true) {
             for (int i = 0; i < ASSOCIATIVITY; i++) {
                 uint64_t slot_id = bucket_id * ASSOCIATIVITY + i;
                 if (i < ASSOCIATIVITY - 1) {
-                    //data part
-                    if (vertices[slot_id].key == key) {
-                        //we found it
-                        return vertices[slot_id];
-                    }
+                    if (vertices[slot_id].key == key)
+                        return vertices[slot_id]; // found
                 } else {
                     if (vertices[slot_id].key.is_empty())
                         return vertex_t(); // not found
@@ -672,6 +1158,16 @@ done:
             return NULL; // not found
         }
 
+#ifdef INLINE_EDGES
+        // the inlined edge is fetched with the vertex, return it in the RDMA buffer as well
+        if (v.ptr.is_inlined()) {
+            edge_ptr = (edge_t *)mem->buffer(tid);
+            edge_ptr[0].val = *v.ptr.inlined_val();
+            *sz = 1;
+            return edge_ptr;
+        }
+#endif
+
         edge_ptr = rdma_get_edges(tid, dst_sid, v);
 #ifdef DYNAMIC_GSTORE
         // check the validation of edges
@@ -683,23 +1179,21 @@ done:
         }
 #endif
 
-        *sz = v.ptr.size;
-        return edge_ptr;
+        return decode_edges(edge_ptr, v.ptr, sz, edge_bufs[tid]);
     }
 
     // Get local edges according to given vid, dir, pid.
     // @sz: size of return edges
     edge_t *get_edges_local(int tid, sid_t vid, dir_t d, sid_t pid, uint64_t *sz) {
         ikey_t key = ikey_t(vid, pid, d);
-        vertex_t v = get_vertex_local(tid, key);
+        vertex_t *v = find_vertex_local(key);
 
-        if (v.key.is_empty()) {
+        if (v == NULL) {
             *sz = 0;
             return NULL;
         }
 
-        *sz = v.ptr.size;
-        return &(edges[v.ptr.off]);
+        return decode_edges(local_edges(*v), v->ptr, sz, edge_bufs[tid]);
     }
 
     // get the attribute value from remote
@@ -849,7 +1343,7 @@ public:
         edge_allocator = new Buddy_Malloc();
         pthread_spin_init(&free_queue_lock, 0);
         lease = SEC(120);
-        rdma_cache = RDMA_Cache(lease);
+        rdma_cache.set_lease(lease);
 #else
         pthread_spin_init(&entry_lock, 0);
 #endif
@@ -864,6 +1358,10 @@ public:
         pthread_spin_init(&bucket_ext_lock, 0);
         for (int i = 0; i < NUM_LOCKS; i++)
             pthread_spin_init(&bucket_locks[i], 0);
+
+        edge_bufs.resize(global_num_threads);
+        batch_bufs.resize(global_num_threads);
+        key_filters.resize(global_num_servers);
     }
 
     void refresh() {
@@ -875,13 +1373,187 @@ public:
 
         last_ext = 0;
 
+        key_filters_synced = false;
+        for (auto &f : key_filters)
+            f.clear();
+
 #ifdef DYNAMIC_GSTORE
+        ext_chunks.clear();
+        num_borrowed_ext = 0;
         edge_allocator->init((void *)edges, num_entries * sizeof(edge_t), global_num_engines);
 #else
         last_entry = 0;
 #endif
     }
 
+    /// Snapshot of gstore (kvstore) for fast restart
+    ///
+    /// format: header | statistics (optional) | header region (used buckets) | entry region (used) | magic
+    /// The snapshot is only valid for the same build options, dataset, #servers and gstore size.
+    static const uint64_t SNAPSHOT_MAGIC = 0x544F4853504E5357ull; // "WSNPSHOT"
+    static const uint64_t SNAPSHOT_VERSION = 2;
+
+    struct snapshot_header_t {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t options;    // build options which change the layout of gstore
+        uint64_t num_servers;
+        uint64_t sid;
+        uint64_t kvstore_size;
+        uint64_t num_slots;
+        uint64_t num_buckets;
+        uint64_t num_buckets_ext;
+        uint64_t num_entries;
+        uint64_t last_ext;
+        uint64_t last_entry;
+        uint64_t stat_size;  // the size of (serialized) statistics, 0 means no statistics
+        char dataset[256];
+    };
+
+    static uint64_t snapshot_options() {
+        uint64_t options = 0;
+#ifdef VERSATILE
+        options |= 1 << 0;
+#endif
+#ifdef DTYPE_64BIT
+        options |= 1 << 1;
+#endif
+#ifdef COMPRESSED_EDGES
+        options |= 1 << 2;
+#endif
+        return options;
+    }
+
+    void init_snapshot_header(snapshot_header_t &hdr, string dataset) {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = SNAPSHOT_MAGIC;
+        hdr.version = SNAPSHOT_VERSION;
+        hdr.options = snapshot_options();
+        hdr.num_servers = global_num_servers;
+        hdr.sid = sid;
+        hdr.kvstore_size = mem->kvstore_size();
+        hdr.num_slots = num_slots;
+        hdr.num_buckets = num_buckets;
+        hdr.num_buckets_ext = num_buckets_ext;
+        hdr.num_entries = num_entries;
+        strncpy(hdr.dataset, dataset.c_str(), sizeof(hdr.dataset) - 1);
+    }
+
+    // Store the snapshot of gstore (w/ serialized statistics) to the file.
+    bool store_snapshot(string fname, string dataset, const string &stat) {
+#ifdef DYNAMIC_GSTORE
+        /// FIXME: the buddy allocator keeps absolute pointers, which can not be restored
+        logstream(LOG_WARNING) << "snapshot is not supported by dynamic gstore." << LOG_endl;
+        return false;
+#else
+        snapshot_header_t hdr;
+        init_snapshot_header(hdr, dataset);
+        hdr.last_ext = last_ext;
+        hdr.last_entry = last_entry;
+        hdr.stat_size = stat.size();
+
+        // write to a temporary file and rename it, avoiding a partially written snapshot
+        string tmp = fname + ".tmp";
+        ofstream ofs(tmp.c_str(), ios::binary | ios::trunc);
+        if (!ofs.good()) {
+            logstream(LOG_ERROR) << "failed to create snapshot " << tmp << LOG_endl;
+            return false;
+        }
+
+        ofs.write((char *)&hdr, sizeof(hdr));
+        ofs.write(stat.data(), stat.size());
+        ofs.write((char *)vertices, (num_buckets + last_ext) * ASSOCIATIVITY * sizeof(vertex_t));
+        ofs.write((char *)edges, last_entry * sizeof(edge_t));
+        ofs.write((char *)&hdr.magic, sizeof(hdr.magic));
+        ofs.close();
+
+        if (!ofs.good() || rename(tmp.c_str(), fname.c_str()) != 0) {
+            logstream(LOG_ERROR) << "failed to write snapshot " << fname << LOG_endl;
+            remove(tmp.c_str());
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    // Restore gstore (w/ serialized statistics) from the snapshot file.
+    // Return false if the snapshot does not exist or is stale.
+    bool load_snapshot(string fname, string dataset, string &stat) {
+#ifdef DYNAMIC_GSTORE
+        logstream(LOG_WARNING) << "snapshot is not supported by dynamic gstore." << LOG_endl;
+        return false;
+#else
+        ifstream ifs(fname.c_str(), ios::binary);
+        if (!ifs.good()) {
+            logstream(LOG_INFO) << "snapshot " << fname << " does not exist." << LOG_endl;
+            return false;
+        }
+
+        snapshot_header_t hdr, expect;
+        init_snapshot_header(expect, dataset);
+        ifs.read((char *)&hdr, sizeof(hdr));
+        if (!ifs.good()
+                || hdr.magic != expect.magic
+                || hdr.version != expect.version
+                || hdr.options != expect.options
+                || hdr.num_servers != expect.num_servers
+                || hdr.sid != expect.sid
+                || hdr.kvstore_size != expect.kvstore_size
+                || hdr.num_slots != expect.num_slots
+                || hdr.num_buckets != expect.num_buckets
+                || hdr.num_buckets_ext != expect.num_buckets_ext
+                || hdr.num_entries != expect.num_entries
+                || strncmp(hdr.dataset, expect.dataset, sizeof(hdr.dataset)) != 0
+                || hdr.last_ext > num_buckets_ext
+                || hdr.last_entry > num_entries) {
+            logstream(LOG_WARNING) << "snapshot " << fname << " is stale (mismatched format, "
+                                   << "build options, dataset or configuration)." << LOG_endl;
+            return false;
+        }
+
+        // the sizes read from the snapshot must match the size of file
+        uint64_t vertices_sz = (num_buckets + hdr.last_ext) * ASSOCIATIVITY * sizeof(vertex_t);
+        uint64_t edges_sz = hdr.last_entry * sizeof(edge_t);
+        ifs.seekg(0, ios::end);
+        uint64_t file_sz = ifs.tellg();
+        ifs.seekg(sizeof(hdr), ios::beg);
+        if (!ifs.good()
+                || hdr.stat_size > file_sz
+                || file_sz != sizeof(hdr) + hdr.stat_size + vertices_sz + edges_sz + sizeof(hdr.magic)) {
+            logstream(LOG_WARNING) << "snapshot " << fname << " is truncated." << LOG_endl;
+            return false;
+        }
+
+        stat.resize(hdr.stat_size);
+        ifs.read(&stat[0], hdr.stat_size);
+        if (!ifs.good()) {
+            logstream(LOG_WARNING) << "snapshot " << fname << " is truncated." << LOG_endl;
+            stat.clear();
+            return false;
+        }
+
+        refresh();
+        last_ext = hdr.last_ext;
+        last_entry = hdr.last_entry;
+        ifs.read((char *)vertices, vertices_sz);
+        if (ifs.good())
+            ifs.read((char *)edges, edges_sz);
+
+        uint64_t magic = 0;
+        if (ifs.good())
+            ifs.read((char *)&magic, sizeof(magic));
+        if (!ifs.good() || magic != SNAPSHOT_MAGIC) {
+            logstream(LOG_WARNING) << "snapshot " << fname << " is truncated." << LOG_endl;
+            refresh();
+            stat.clear();
+            return false;
+        }
+
+        build_key_filter();
+        return true;
+#endif
+    }
+
     /// skip all TYPE triples (e.g., <http://www.Department0.University0.edu> rdf:type ub:University)
     /// because Wukong treats all TYPE triples as index vertices. In addition, the triples in triple_ops
     /// has been sorted by the vid of object, and IDs of types are always smaller than normal vertex IDs.
@@ -903,6 +1575,7 @@ public:
         vector<sid_t> predicates;
 #endif // VERSATILE
 
+        vector<sid_t> vals;
         uint64_t s = 0;
         while (s < spo.size()) {
             // predicate-based key (subject + predicate)
@@ -911,18 +1584,15 @@ public:
                     && (spo[s].s == spo[e].s)
                     && (spo[s].p == spo[e].p))  { e++; }
 
-            // allocate a vertex and edges
-            ikey_t key = ikey_t(spo[s].s, spo[s].p, OUT);
-            uint64_t off = alloc_edges(e - s, tid);
-
             // insert a vertex
+            ikey_t key = ikey_t(spo[s].s, spo[s].p, OUT);
             uint64_t slot_id = insert_key(key);
-            iptr_t ptr = iptr_t(e - s, off);
-            vertices[slot_id].ptr = ptr;
 
-            // insert edges
+            // insert edges (already sorted, since spo is sorted by (s, p, o))
+            vals.clear();
             for (uint64_t i = s; i < e; i++)
-                edges[off++].val = spo[i].o;
+                vals.push_back(spo[i].o);
+            insert_edges(slot_id, vals.data(), vals.size(), tid);
 
 #ifdef VERSATILE
             // add a new predicate
@@ -930,19 +1600,12 @@ public:
 
             // insert a special PREDICATE triple (OUT)
             if (e >= spo.size() || spo[s].s != spo[e].s) {
-                // allocate a vertex and edges
-                ikey_t key = ikey_t(spo[s].s, PREDICATE_ID, OUT);
-                uint64_t sz = predicates.size();
-                uint64_t off = alloc_edges(sz, tid);
-
                 // insert a vertex
+                ikey_t key = ikey_t(spo[s].s, PREDICATE_ID, OUT);
                 uint64_t slot_id = insert_key(key);
-                iptr_t ptr = iptr_t(sz, off);
-                vertices[slot_id].ptr = ptr;
 
-                // insert edges
-                for (auto const &p : predicates)
-                    edges[off++].val = p;
+                // insert edges (already sorted)
+                insert_edges(slot_id, predicates.data(), predicates.size(), tid);
 
                 predicates.clear();
             }
@@ -959,18 +1622,15 @@ public:
                     && (ops[s].o == ops[e].o)
                     && (ops[s].p == ops[e].p)) { e++; }
 
-            // allocate a vertex and edges
-            ikey_t key = ikey_t(ops[s].o, ops[s].p, IN);
-            uint64_t off = alloc_edges(e - s, tid);
-
             // insert a vertex
+            ikey_t key = ikey_t(ops[s].o, ops[s].p, IN);
             uint64_t slot_id = insert_key(key);
-            iptr_t ptr = iptr_t(e - s, off);
-            vertices[slot_id].ptr = ptr;
 
-            // insert edges
+            // insert edges (already sorted, since ops is sorted by (o, p, s))
+            vals.clear();
             for (uint64_t i = s; i < e; i++)
-                edges[off++].val = ops[i].s;
+                vals.push_back(ops[i].s);
+            insert_edges(slot_id, vals.data(), vals.size(), tid);
 
 #ifdef VERSATILE
             // add a new predicate
@@ -978,19 +1638,12 @@ public:
 
             // insert a special PREDICATE triple (OUT)
             if (e >= ops.size() || ops[s].o != ops[e].o) {
-                // allocate a vertex and edges
-                ikey_t key = ikey_t(ops[s].o, PREDICATE_ID, IN);
-                uint64_t sz = predicates.size();
-                uint64_t off = alloc_edges(sz, tid);
-
                 // insert a vertex
+                ikey_t key = ikey_t(ops[s].o, PREDICATE_ID, IN);
                 uint64_t slot_id = insert_key(key);
-                iptr_t ptr = iptr_t(sz, off);
-                vertices[slot_id].ptr = ptr;
 
-                // insert edges
-                for (auto const &p : predicates)
-                    edges[off++].val = p;
+                // insert edges (already sorted)
+                insert_edges(slot_id, predicates.data(), predicates.size(), tid);
 
                 predicates.clear();
             }
@@ -1008,60 +1661,66 @@ public:
         edge_allocator->merge_freelists();
 #endif
         // scan raw data to generate index data in parallel
-        #pragma omp parallel for num_threads(global_num_engines)
-        for (uint64_t bucket_id = 0; bucket_id < num_buckets + last_ext; bucket_id++) {
-            uint64_t slot_id = bucket_id * ASSOCIATIVITY;
-            for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
-                // skip empty slot
-                if (vertices[slot_id].key.is_empty()) break;
-
-                sid_t vid = vertices[slot_id].key.vid;
-                sid_t pid = vertices[slot_id].key.pid;
-
-                uint64_t sz = vertices[slot_id].ptr.size;
-                uint64_t off = vertices[slot_id].ptr.off;
-
-                if (vertices[slot_id].key.dir == IN) {
-                    if (pid == PREDICATE_ID) {
+        for (auto const &r : bucket_ranges()) {
+            #pragma omp parallel for num_threads(global_num_engines)
+            for (uint64_t bucket_id = r.first; bucket_id < r.second; bucket_id++) {
+                uint64_t slot_id = bucket_id * ASSOCIATIVITY;
+                vector<sid_t> buf; // decode compressed edges
+                for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
+                    // skip empty slot
+                    if (vertices[slot_id].key.is_empty()) break;
+
+                    sid_t vid = vertices[slot_id].key.vid;
+                    sid_t pid = vertices[slot_id].key.pid;
+
+                    // only the edges of predicate/type vertices are used
+                    uint64_t sz = 0;
+                    edge_t *vals = NULL;
+                    if (pid == PREDICATE_ID || pid == TYPE_ID)
+                        vals = decode_edges(local_edges(vertices[slot_id]), vertices[slot_id].ptr, &sz, buf);
+
+                    if (vertices[slot_id].key.dir == IN) {
+                        if (pid == PREDICATE_ID) {
 #ifdef VERSATILE
-                        // every subject/object has at least one predicate or one type
-                        v_set.insert(vid); // collect all local objects w/ predicate
-                        for (uint64_t e = 0; e < sz; e++)
-                            p_set.insert(edges[off + e].val); // collect all local predicates
+                            // every subject/object has at least one predicate or one type
+                            v_set.insert(vid); // collect all local objects w/ predicate
+                            for (uint64_t e = 0; e < sz; e++)
+                                p_set.insert(vals[e].val); // collect all local predicates
 #endif
-                    } else if (pid == TYPE_ID) {
-                        ASSERT(false); // (IN) type triples should be skipped
-                    } else { // predicate-index (OUT) vid
-                        tbb_hash_map::accessor a;
-                        pidx_out_map.insert(a, pid);
-                        a->second.push_back(vid);
-                    }
-                } else {
-                    if (pid == PREDICATE_ID) {
+                        } else if (pid == TYPE_ID) {
+                            ASSERT(false); // (IN) type triples should be skipped
+                        } else { // predicate-index (OUT) vid
+                            tbb_hash_map::accessor a;
+                            pidx_out_map.insert(a, pid);
+                            a->second.push_back(vid);
+                        }
+                    } else {
+                        if (pid == PREDICATE_ID) {
 #ifdef VERSATILE
-                        // every subject/object has at least one predicate or one type
-                        v_set.insert(vid); // collect all local subjects w/ predicate
-                        for (uint64_t e = 0; e < sz; e++)
-                            p_set.insert(edges[off + e].val); // collect all local predicates
+                            // every subject/object has at least one predicate or one type
+                            v_set.insert(vid); // collect all local subjects w/ predicate
+                            for (uint64_t e = 0; e < sz; e++)
+                                p_set.insert(vals[e].val); // collect all local predicates
 #endif
-                    } else if (pid == TYPE_ID) {
+                        } else if (pid == TYPE_ID) {
 #ifdef VERSATILE
-                        // every subject/object has at least one predicate or one type
-                        v_set.insert(vid); // collect all local subjects w/ type
+                            // every subject/object has at least one predicate or one type
+                            v_set.insert(vid); // collect all local subjects w/ type
 #endif
-                        // type-index (IN) vid
-                        for (uint64_t e = 0; e < sz; e++) {
-                            tbb_hash_map::accessor a;
-                            tidx_map.insert(a, edges[off + e].val);
-                            a->second.push_back(vid);
+                            // type-index (IN) vid
+                            for (uint64_t e = 0; e < sz; e++) {
+                                tbb_hash_map::accessor a;
+                                tidx_map.insert(a, vals[e].val);
+                                a->second.push_back(vid);
 #ifdef VERSATILE
-                            t_set.insert(edges[off + e].val); // collect all local types
+                                t_set.insert(vals[e].val); // collect all local types
 #endif
+                            }
+                        } else { // predicate-index (IN) vid
+                            tbb_hash_map::accessor a;
+                            pidx_in_map.insert(a, pid);
+                            a->second.push_back(vid);
                         }
-                    } else { // predicate-index (IN) vid
-                        tbb_hash_map::accessor a;
-                        pidx_in_map.insert(a, pid);
-                        a->second.push_back(vid);
                     }
                 }
             }
@@ -1092,8 +1751,39 @@ public:
 
         uint64_t t3 = timer::get_usec();
         logstream(LOG_DEBUG) << (t3 - t2) / 1000 << " ms for inserting index data into gstore" << LOG_endl;
+
+        build_key_filter();
+    }
+
+    // Build the (local) Bloom filter over all keys, sized by the number of keys.
+    void build_key_filter() {
+        Bloom_Filter &filter = key_filters[sid];
+        filter.clear();
+        if (global_key_filter_bits == 0)
+            return;
+
+        vector<pair<uint64_t, uint64_t>> ranges = bucket_ranges();
+        uint64_t nkeys = 0;
+        for (auto const &r : ranges)
+            for (uint64_t slot_id = r.first * ASSOCIATIVITY; slot_id < r.second * ASSOCIATIVITY; slot_id++)
+                if (slot_id % ASSOCIATIVITY != ASSOCIATIVITY - 1 && !vertices[slot_id].key.is_empty())
+                    nkeys++;
+
+        filter.init(nkeys, global_key_filter_bits);
+        for (auto const &r : ranges) {
+            #pragma omp parallel for num_threads(global_num_engines)
+            for (uint64_t slot_id = r.first * ASSOCIATIVITY; slot_id < r.second * ASSOCIATIVITY; slot_id++)
+                if (slot_id % ASSOCIATIVITY != ASSOCIATIVITY - 1 && !vertices[slot_id].key.is_empty())
+                    filter.insert(vertices[slot_id].key.hash());
+        }
     }
 
+    Bloom_Filter &get_key_filter(int s) { return key_filters[s]; }
+
+    // Enable (or disable) to skip remote lookups by the replicas of filters.
+    // NOTE: the replicas become stale once other servers insert new keys (dynamic loading).
+    void set_key_filters_synced(bool synced) { key_filters_synced = synced; }
+
 #ifdef DYNAMIC_GSTORE
     void insert_triple_out(const triple_t &triple, bool check_dup) {
         bool dedup_or_isdup = check_dup;
@@ -1534,11 +2224,13 @@ public:
         logstream(LOG_INFO) << "Graph storage intergity check has started on server " << sid << LOG_endl;
         ivertex_num = 0;
         nvertex_num = 0;
-        for (uint64_t bucket_id = 0; bucket_id < num_buckets + num_buckets_ext; bucket_id++) {
-            uint64_t slot_id = bucket_id * ASSOCIATIVITY;
-            for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
-                if (!vertices[slot_id].key.is_empty()) {
-                    check_on_vertex(vertices[slot_id].key, index_check, normal_check);
+        for (auto const &r : bucket_ranges()) {
+            for (uint64_t bucket_id = r.first; bucket_id < r.second; bucket_id++) {
+                uint64_t slot_id = bucket_id * ASSOCIATIVITY;
+                for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
+                    if (!vertices[slot_id].key.is_empty()) {
+                        check_on_vertex(vertices[slot_id].key, index_check, normal_check);
+                    }
                 }
             }
         }
@@ -1548,14 +2240,193 @@ public:
         return 0;
     }
 
+    // Whether the edges of given vertex are stored locally.
+    // NOTE: the loopback RDMA device fetches all edges by (loopback) RDMA reads,
+    //       so that the remote path can be evaluated on a single server.
+    inline bool is_local(sid_t vid) {
+#ifdef RDMA_LOOPBACK
+        return false;
+#else
+        return mymath::hash_mod(vid, global_num_servers) == sid;
+#endif
+    }
+
     // FIXME: refine parameters with vertex_t
     edge_t *get_edges_global(int tid, sid_t vid, dir_t d, sid_t pid, uint64_t *sz) {
-        if (mymath::hash_mod(vid, global_num_servers) == sid)
+        if (is_local(vid))
             return get_edges_local(tid, vid, d, pid, sz);
         else
             return get_edges_remote(tid, vid, d, pid, sz);
     }
 
+    /// Get the edges of a batch of keys (from @keys[@first]) to @spans.
+    /// The lookups of remote keys are issued together by batched RDMA reads (first the buckets,
+    /// then the edges), so that their round trips are overlapped. The remote edges are read to
+    /// the RDMA buffer of the thread, so the spans are only valid until the next lookup.
+    ///
+    /// @return the number of keys returned in @spans (at least one), which is limited by
+    ///         BATCH_SIZE and the space of the RDMA buffer.
+    static const uint64_t BATCH_SIZE = 256;
+
+    uint64_t get_edges_batch(int tid, const vector<ikey_t> &keys, uint64_t first,
+                             vector<edge_span_t> &spans) {
+        ASSERT(first < keys.size());
+        uint64_t n = min(keys.size() - first, BATCH_SIZE);
+        char *buf = mem->buffer(tid);
+        uint64_t buf_sz = mem->buffer_size();
+
+        bool all_local = true;
+        for (uint64_t j = 0; j < n && all_local; j++)
+            all_local = is_local(keys[first + j].vid);
+
+        // no RDMA read is needed (or there is no RDMA buffer, i.e., RDMA is off),
+        // then the keys are looked up one by one
+        if (all_local || buf_sz == 0) {
+            vector<sid_t> &dbuf = batch_bufs[tid];
+            vector<uint64_t> doffs(n, 0);
+            vector<bool> copied(n, false);
+            dbuf.clear();
+            spans.assign(n, edge_span_t());
+            for (uint64_t j = 0; j < n; j++) {
+                ikey_t key = keys[first + j];
+                uint64_t sz = 0;
+                edge_t *ptr = get_edges_global(tid, key.vid, (dir_t)key.dir, key.pid, &sz);
+                spans[j] = edge_span_t(ptr, sz);
+#ifndef COMPRESSED_EDGES
+                if (is_local(key.vid)) continue;
+#endif
+                // the decoded (or remote) edges are in a per-thread buffer reused by next lookup
+                doffs[j] = dbuf.size();
+                dbuf.insert(dbuf.end(), (sid_t *)ptr, (sid_t *)ptr + sz);
+                copied[j] = true;
+            }
+
+            for (uint64_t j = 0; j < n; j++)
+                if (copied[j] && spans[j].sz > 0)
+                    spans[j].ptr = (edge_t *)&dbuf[doffs[j]];
+            return n;
+        }
+
+        uint64_t bucket_sz = ASSOCIATIVITY * sizeof(vertex_t);
+        ASSERT(n * bucket_sz <= buf_sz);
+
+        vector<vertex_t> verts(n);
+        vector<uint64_t> remotes;
+        for (uint64_t j = 0; j < n; j++) {
+            ikey_t key = keys[first + j];
+            if (is_local(key.vid))
+                verts[j] = get_vertex_local(tid, key);
+            else
+                remotes.push_back(first + j);
+        }
+
+        // 1. read the buckets of remote keys (to the beginning of the buffer)
+        vector<vertex_t> rverts(remotes.size());
+        if (!remotes.empty())
+            get_vertices_remote_batch(tid, keys, remotes, rverts.data(), buf);
+        for (uint64_t k = 0; k < remotes.size(); k++)
+            verts[remotes[k] - first] = rverts[k];
+
+        // 2. read the edges of remote keys (reuse the buffer since the buckets are consumed)
+        //    the batch is cut at the first key whose edges cannot fit in the buffer
+        vector<uint64_t> offs(n, 0);
+        vector<rdma_read_req_t> reqs;
+        uint64_t used = 0;
+        for (uint64_t k = 0; k < remotes.size(); k++) {
+            uint64_t j = remotes[k] - first;
+            if (verts[j].key.is_empty() || verts[j].ptr.is_inlined()) continue;
+
+            uint64_t r_sz = rdma_edges_size(verts[j]);
+            if (used + r_sz > buf_sz) {
+                n = j;
+                break;
+            }
+
+            int dst_sid = mymath::hash_mod(verts[j].key.vid, global_num_servers);
+            reqs.push_back(rdma_read_req_t(dst_sid, buf + used, r_sz, rdma_edges_off(verts[j])));
+            offs[j] = used;
+            used += r_sz;
+        }
+
+        if (n == 0) {
+            // the edges of the first key are too many to be batched
+            uint64_t sz = 0;
+            ikey_t key = keys[first];
+            edge_t *ptr = get_edges_remote(tid, key.vid, (dir_t)key.dir, key.pid, &sz);
+            spans.assign(1, edge_span_t(ptr, sz));
+            return 1;
+        }
+
+        RDMA &rdma = RDMA::get_rdma();
+        if (!reqs.empty())
+            rdma.dev->RdmaReadBatch(tid, reqs);
+
+        // 3. return (and decode) the edges
+        // the copied (decoded) edges are pointed at last since the buffer is resizable
+        vector<sid_t> &dbuf = batch_bufs[tid];
+        vector<uint64_t> doffs(n, 0);
+        vector<bool> copied(n, false);
+        dbuf.clear();
+        spans.assign(n, edge_span_t());
+        auto copy_edges = [&](uint64_t j, const sid_t *vals, uint64_t sz) {
+            doffs[j] = dbuf.size();
+            dbuf.insert(dbuf.end(), vals, vals + sz);
+            spans[j].sz = sz;
+            copied[j] = true;
+        };
+
+#ifdef DYNAMIC_GSTORE
+        // the edges may be moved after the lookup, then they are re-fetched one by one,
+        // which reuses the RDMA buffer, so the other remote edges are copied in advance
+        vector<uint64_t> stale;
+        for (uint64_t j = 0; j < n; j++)
+            if (!verts[j].key.is_empty() && !is_local(verts[j].key.vid)
+                    && !edge_is_valid(verts[j], (edge_t *)(buf + offs[j])))
+                stale.push_back(j);
+
+        if (!stale.empty()) {
+            for (uint64_t j = 0; j < n; j++)
+                if (!verts[j].key.is_empty() && !is_local(verts[j].key.vid)
+                        && find(stale.begin(), stale.end(), j) == stale.end())
+                    copy_edges(j, (sid_t *)(buf + offs[j]), verts[j].ptr.size);
+
+            for (auto j : stale) {
+                ikey_t key = verts[j].key;
+                uint64_t sz = 0;
+                edge_t *e = get_edges_remote(tid, key.vid, (dir_t)key.dir, key.pid, &sz);
+                copy_edges(j, (sid_t *)e, sz);
+            }
+        }
+#endif
+
+        for (uint64_t j = 0; j < n; j++) {
+            vertex_t &v = verts[j];
+            if (v.key.is_empty() || copied[j])
+                continue;
+
+#ifdef INLINE_EDGES
+            if (v.ptr.is_inlined()) {
+                copy_edges(j, v.ptr.inlined_val(), 1);
+                continue;
+            }
+#endif
+
+            edge_t *ptr = is_local(v.key.vid) ? &edges[v.ptr.off] : (edge_t *)(buf + offs[j]);
+#ifdef COMPRESSED_EDGES
+            uint64_t sz = 0;
+            const sid_t *vals = EdgeCodec::decode((sid_t *)ptr, v.ptr.size, &sz, edge_bufs[tid]);
+            copy_edges(j, vals, sz);
+#else
+            spans[j] = edge_span_t(ptr, v.ptr.size);
+#endif
+        }
+
+        for (uint64_t j = 0; j < n; j++)
+            if (copied[j] && spans[j].sz > 0)
+                spans[j].ptr = (edge_t *)&dbuf[doffs[j]];
+        return n;
+    }
+
     edge_t *get_index_edges_local(int tid, sid_t pid, dir_t d, uint64_t *sz) {
         // the vid of index vertex should be 0
         return get_edges_local(tid, 0, d, pid, sz);
@@ -1604,71 +2475,74 @@ public:
 
     // prepare data for planner
     void generate_statistic(data_statistic & stat) {
-        for (uint64_t bucket_id = 0; bucket_id < num_buckets + num_buckets_ext; bucket_id++) {
-            uint64_t slot_id = bucket_id * ASSOCIATIVITY;
-            for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
-                // skip empty slot
-                if (vertices[slot_id].key.is_empty()) continue;
-
-                sid_t vid = vertices[slot_id].key.vid;
-                sid_t pid = vertices[slot_id].key.pid;
-
-                uint64_t off = vertices[slot_id].ptr.off;
-                if (pid == PREDICATE_ID) continue; // skip for index vertex
-
-                unordered_map<ssid_t, int> &ptcount = stat.predicate_to_triple;
-                unordered_map<ssid_t, int> &pscount = stat.predicate_to_subject;
-                unordered_map<ssid_t, int> &pocount = stat.predicate_to_object;
-                unordered_map<ssid_t, int> &tyscount = stat.type_to_subject;
-                unordered_map<ssid_t, vector<direct_p> > &ipcount = stat.id_to_predicate;
-
-                if (vertices[slot_id].key.dir == IN) {
-                    uint64_t sz = vertices[slot_id].ptr.size;
-
-                    // triples only count from one direction
-                    if (ptcount.find(pid) == ptcount.end())
-                        ptcount[pid] = sz;
-                    else
-                        ptcount[pid] += sz;
-
-                    // count objects
-                    if (pocount.find(pid) == pocount.end())
-                        pocount[pid] = 1;
-                    else
-                        pocount[pid]++;
-
-                    // count in predicates for specific id
-                    ipcount[vid].push_back(direct_p(IN, pid));
-                } else {
-                    // count subjects
-                    if (pscount.find(pid) == pscount.end())
-                        pscount[pid] = 1;
-                    else
-                        pscount[pid]++;
-
-                    // count out predicates for specific id
-                    ipcount[vid].push_back(direct_p(OUT, pid));
-
-                    // count type predicate
-                    if (pid == TYPE_ID) {
-                        uint64_t sz = vertices[slot_id].ptr.size;
-                        uint64_t off = vertices[slot_id].ptr.off;
-
-                        for (uint64_t j = 0; j < sz; j++) {
-                            //src may belongs to multiple types
-                            sid_t obid = edges[off + j].val;
-
-                            if (tyscount.find(obid) == tyscount.end())
-                                tyscount[obid] = 1;
-                            else
-                                tyscount[obid]++;
-
-                            if (pscount.find(obid) == pscount.end())
-                                pscount[obid] = 1;
-                            else
-                                pscount[obid]++;
-
-                            ipcount[vid].push_back(direct_p(OUT, obid));
+        vector<sid_t> buf; // decode compressed edges
+        for (auto const &r : bucket_ranges()) {
+            for (uint64_t bucket_id = r.first; bucket_id < r.second; bucket_id++) {
+                uint64_t slot_id = bucket_id * ASSOCIATIVITY;
+                for (int i = 0; i < ASSOCIATIVITY - 1; i++, slot_id++) {
+                    // skip empty slot
+                    if (vertices[slot_id].key.is_empty()) continue;
+
+                    sid_t vid = vertices[slot_id].key.vid;
+                    sid_t pid = vertices[slot_id].key.pid;
+
+                    uint64_t off = vertices[slot_id].ptr.off;
+                    if (pid == PREDICATE_ID) continue; // skip for index vertex
+
+                    unordered_map<ssid_t, int> &ptcount = stat.predicate_to_triple;
+                    unordered_map<ssid_t, int> &pscount = stat.predicate_to_subject;
+                    unordered_map<ssid_t, int> &pocount = stat.predicate_to_object;
+                    unordered_map<ssid_t, int> &tyscount = stat.type_to_subject;
+                    unordered_map<ssid_t, vector<direct_p> > &ipcount = stat.id_to_predicate;
+
+                    if (vertices[slot_id].key.dir == IN) {
+                        uint64_t sz = count_edges(vertices[slot_id]);
+
+                        // triples only count from one direction
+                        if (ptcount.find(pid) == ptcount.end())
+                            ptcount[pid] = sz;
+                        else
+                            ptcount[pid] += sz;
+
+                        // count objects
+                        if (pocount.find(pid) == pocount.end())
+                            pocount[pid] = 1;
+                        else
+                            pocount[pid]++;
+
+                        // count in predicates for specific id
+                        ipcount[vid].push_back(direct_p(IN, pid));
+                    } else {
+                        // count subjects
+                        if (pscount.find(pid) == pscount.end())
+                            pscount[pid] = 1;
+                        else
+                            pscount[pid]++;
+
+                        // count out predicates for specific id
+                        ipcount[vid].push_back(direct_p(OUT, pid));
+
+                        // count type predicate
+                        if (pid == TYPE_ID) {
+                            uint64_t sz = 0;
+                            edge_t *vals = decode_edges(local_edges(vertices[slot_id]), vertices[slot_id].ptr, &sz, buf);
+
+                            for (uint64_t j = 0; j < sz; j++) {
+                                //src may belongs to multiple types
+                                sid_t obid = vals[j].val;
+
+                                if (tyscount.find(obid) == tyscount.end())
+                                    tyscount[obid] = 1;
+                                else
+                                    tyscount[obid]++;
+
+                                if (pscount.find(obid) == pscount.end())
+                                    pscount[obid] = 1;
+                                else
+                                    pscount[obid]++;
+
+                                ipcount[vid].push_back(direct_p(OUT, obid));
+                            }
                         }
                     }
                 }
@@ -1757,6 +2631,11 @@ public:
                             << " % (" << last_ext << " buckets)" << LOG_endl;
         logstream(LOG_INFO) << "\tused: " << 100.0 * used_slots / (num_buckets_ext * ASSOCIATIVITY)
                             << " % (" << used_slots << " slots)" << LOG_endl;
+#ifdef DYNAMIC_GSTORE
+        logstream(LOG_INFO) << "\tborrowed: " << B2MiB(ext_chunks.size() * EXT_CHUNK_BUCKETS * ASSOCIATIVITY * sizeof(vertex_t))
+                            << " MB (" << num_borrowed_ext << " buckets in "
+                            << ext_chunks.size() << " chunks)" << LOG_endl;
+#endif
 
         logstream(LOG_INFO) << "entry: " << B2MiB(num_entries * sizeof(edge_t))
                             << " MB (" << num_entries << " entries)" << LOG_endl;
@@ -1767,10 +2646,61 @@ public:
                             << " % (" << last_entry << " entries)" << LOG_endl;
 #endif
 
+        if (!key_filters[sid].empty()) {
+            uint64_t filter_sz = 0;
+            for (auto const &f : key_filters)
+                filter_sz += f.size();
+            logstream(LOG_INFO) << "key filters: " << B2MiB(filter_sz) << " MB (local = "
+                                << B2MiB(key_filters[sid].size()) << " MB)" << LOG_endl;
+        }
+
         uint64_t sz = 0;
         get_edges_local(0, 0, IN, TYPE_ID, &sz);
         logstream(LOG_INFO) << "#vertices: " << sz << LOG_endl;
         get_edges_local(0, 0, OUT, TYPE_ID, &sz);
         logstream(LOG_INFO) << "#predicates: " << sz << LOG_endl;
+
+        if (global_use_rdma)
+            rdma_cache.print_stats();
+    }
+
+    // micro-benchmark: compare the probe latency w/ and w/o fingerprints on (sampled) local keys
+    void print_probe_latency(uint64_t max_samples = 1000000) {
+        vector<ikey_t> samples;
+        samples.reserve(max_samples);
+        for (uint64_t x = 0; x < num_buckets + last_ext && samples.size() < max_samples; x++) {
+            uint64_t slot_id = x * ASSOCIATIVITY;
+            for (int y = 0; y < ASSOCIATIVITY - 1; y++, slot_id++) {
+                if (vertices[slot_id].key.is_empty())
+                    break;
+                samples.push_back(vertices[slot_id].key);
+            }
+        }
+        if (samples.size() == 0) return;
+
+        // avoid the lookups to be optimized away
+        uint64_t sum = 0;
+        uint64_t t1 = timer::get_usec();
+        for (auto const &key : samples)
+            sum += get_vertex_local(0, key).ptr.size;
+        uint64_t t2 = timer::get_usec();
+        for (auto const &key : samples)
+            sum -= get_vertex_local_noprobe(0, key).ptr.size;
+        uint64_t t3 = timer::get_usec();
+        ASSERT(sum == 0);
+
+        logstream(LOG_INFO) << "probe latency (" << samples.size() << " keys): "
+                            << 1000.0 * (t2 - t1) / samples.size() << " ns (fingerprint) vs. "
+                            << 1000.0 * (t3 - t2) / samples.size() << " ns (slot-by-slot)" << LOG_endl;
+    }
+
+    // the statistics of RDMA cache (summed over all threads)
+    void get_cache_stats(uint64_t &hits, uint64_t &misses, uint64_t &evictions) {
+        rdma_cache.get_stats(hits, misses, evictions);
+    }
+
+    // the statistics of RDMA cache (of given thread)
+    void get_cache_stats(int tid, uint64_t &hits, uint64_t &misses) {
+        rdma_cache.get_stats(tid, hits, misses);
     }
 };
@@ -22,7 +22,12 @@
 
 #pragma once
 
+#include <sys/mman.h>
+#include <thread>
+#include <hwloc.h>
+
 #include "rdma.hpp"
+#include "bind.hpp"
 #include "unit.hpp"
 
 using namespace std;
@@ -36,6 +41,87 @@ private:
     // The rdma-buffer and ring-buffer are only used when HAS_RDMA
     char *mem;
     uint64_t mem_sz;
+    uint64_t map_sz; // aligned to the page size
+
+    // Map anonymous memory w/ huge pages (fallback to smaller pages if failed).
+    char *map_memory(uint64_t sz) {
+        void *ptr = MAP_FAILED;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+        if (global_hugepage_size_mb >= 1024) {
+            map_sz = (sz + GiB2B(1) - 1) / GiB2B(1) * GiB2B(1);
+            ptr = mmap(NULL, map_sz, PROT_READ | PROT_WRITE,
+                       flags | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+            if (ptr == MAP_FAILED)
+                logstream(LOG_WARNING) << "failed to allocate 1GB huge pages, "
+                                       << "fallback to 2MB huge pages." << LOG_endl;
+        }
+
+        if (ptr == MAP_FAILED && global_hugepage_size_mb >= 2) {
+            map_sz = (sz + MiB2B(2) - 1) / MiB2B(2) * MiB2B(2);
+            ptr = mmap(NULL, map_sz, PROT_READ | PROT_WRITE,
+                       flags | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+            if (ptr == MAP_FAILED)
+                logstream(LOG_WARNING) << "failed to allocate 2MB huge pages (HINT: check vm.nr_hugepages), "
+                                       << "fallback to regular pages." << LOG_endl;
+        }
+#endif
+
+        if (ptr == MAP_FAILED) {
+            map_sz = (sz + KiB2B(4) - 1) / KiB2B(4) * KiB2B(4);
+            ptr = mmap(NULL, map_sz, PROT_READ | PROT_WRITE, flags, -1, 0);
+            ASSERT(ptr != MAP_FAILED);
+
+#ifdef MADV_HUGEPAGE
+            // try transparent huge pages instead
+            if (global_hugepage_size_mb > 0)
+                madvise(ptr, map_sz, MADV_HUGEPAGE);
+#endif
+        }
+        return (char *)ptr;
+    }
+
+    // Interleave memory across all NUMA nodes (before touched).
+    void interleave_memory(char *ptr, uint64_t sz) {
+        hwloc_topology_t topology;
+        hwloc_topology_init(&topology);
+        hwloc_topology_load(topology);
+
+        if (hwloc_set_area_membind(topology, ptr, sz, hwloc_topology_get_complete_cpuset(topology),
+                                   HWLOC_MEMBIND_INTERLEAVE, 0) != 0)
+            logstream(LOG_WARNING) << "failed to interleave memory across NUMA nodes." << LOG_endl;
+
+        hwloc_topology_destroy(topology);
+    }
+
+    // Initialize (first-touch) memory in parallel by the threads bound to the cores of
+    // proxies and engines. Thus, the kvstore is spread over the NUMA nodes, and the
+    // buffers of each thread are allocated in its own NUMA node.
+    void touch_memory() {
+        uint64_t chunk = (kvs_sz / num_threads + KiB2B(4) - 1) / KiB2B(4) * KiB2B(4);
+
+        vector<std::thread> threads;
+        for (int tid = 0; tid < num_threads; tid++) {
+            threads.push_back(std::thread([this, tid, chunk]() {
+                if (num_cores > 0)
+                    bind_to_core(core_of_thread(tid));
+
+                uint64_t off = min(chunk * tid, kvs_sz);
+                memset(kvs + off, 0, min(chunk, kvs_sz - off));
+
+                memset(buffer(tid), 0, buf_sz);
+                for (int sid = 0; sid < num_servers; sid++) {
+                    memset(ring(tid, sid), 0, rbf_sz);
+                    memset(local_ring_head(tid, sid), 0, lrbf_hd_sz);
+                    memset(remote_ring_head(tid, sid), 0, rrbf_hd_sz);
+                }
+            }));
+        }
+
+        for (auto &t : threads)
+            t.join();
+    }
 
     char *kvs;
     uint64_t kvs_sz;
@@ -84,8 +170,9 @@ public:
                  + rbf_sz * num_servers * num_threads
                  + lrbf_hd_sz * num_servers * num_threads
                  + rrbf_hd_sz * num_servers * num_threads;
-        mem = (char *)malloc(mem_sz);
-        memset(mem, 0, mem_sz);
+        mem = map_memory(mem_sz);
+        if (global_numa_interleave)
+            interleave_memory(mem, map_sz);
 
         kvs_off = 0;
         kvs = mem + kvs_off;
@@ -101,9 +188,11 @@ public:
 
         rrbf_hd_off = lrbf_hd_off + lrbf_hd_sz * num_servers * num_threads;
         rrbf_hd =  mem + rrbf_hd_off;
+
+        touch_memory();
     }
 
-    ~Mem() { free(mem); }
+    ~Mem() { munmap(mem, map_sz); }
 
     inline char *memory() { return mem; }
     inline uint64_t memory_size() { return mem_sz; }
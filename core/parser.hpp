@@ -193,6 +193,18 @@ private:
                 iter ++)
             sq.orders.push_back(SPARQLQuery::Order((*iter).id, (*iter).descending));
 
+        // group by and aggregates
+        for (SPARQLParser::group_iterator iter = sp.groupBegin();
+                iter != sp.groupEnd();
+                iter ++)
+            sq.group_vars.push_back(*iter);
+        for (SPARQLParser::aggregate_iterator iter = sp.aggregateBegin();
+                iter != sp.aggregateEnd();
+                iter ++)
+            sq.aggregates.push_back(SPARQLQuery::Aggregate(
+                                        (SPARQLQuery::Aggregate::Type)(*iter).type,
+                                        (*iter).id, (*iter).alias));
+
         // limit and offset
         sq.limit = sp.getLimit();
         sq.offset = sp.getOffset();
@@ -215,6 +227,21 @@ private:
         }
     }
 
+    /// Whether @var is bound to attribute values (the object of an attribute pattern) in @group
+    bool is_attr_var(const SPARQLQuery::PatternGroup &group, ssid_t var) {
+        for (auto const &p : group.patterns)
+            if (p.pred_type > 0 && p.object == var)
+                return true;
+
+        for (auto const &u : group.unions)
+            if (is_attr_var(u, var)) return true;
+
+        for (auto const &o : group.optional)
+            if (is_attr_var(o, var)) return true;
+
+        return false;
+    }
+
     void transfer_template(const SPARQLParser &sp, SPARQLQuery_Template &sqt) {
         SPARQLParser::PatternGroup group = sp.getPatterns();
         int pos = 0;
@@ -279,6 +306,15 @@ public:
             return false;
         }
 
+        // the keys of groups must be IDs (see Engine::aggregate)
+        for (auto var : sq.group_vars) {
+            if (is_attr_var(sq.pattern_group, var)) {
+                logstream(LOG_ERROR) << "Unsupported attribute variable in GROUP BY!"
+                                     << LOG_endl;
+                return false;
+            }
+        }
+
         logstream(LOG_INFO) << "Parsing a SPARQL query is done." << LOG_endl;
         return true;
     }
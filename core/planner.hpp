@@ -466,6 +466,33 @@ class Planner {
         }
     }
 
+    // Move the patterns closing a cycle (i.e., both ends are bound variables) right after
+    // the pattern binding one of their ends, so that the engine evaluates them together
+    // by intersecting all neighbor lists (see Engine::known_to_unknown_cyclic).
+    void hoist_cycle_closers(vector<SPARQLQuery::Pattern> &patterns) {
+        set<ssid_t> bound;
+        for (int i = 0; i < patterns.size(); i++) {
+            ssid_t start = patterns[i].subject;
+            ssid_t end = patterns[i].object;
+            bool binds = (start < 0 && bound.count(start) && end < 0 && !bound.count(end));
+            if (start < 0) bound.insert(start);
+            if (end < 0) bound.insert(end);
+            if (!binds) continue;
+
+            int next = i + 1;
+            for (int j = i + 1; j < patterns.size(); j++) {
+                SPARQLQuery::Pattern p = patterns[j];
+                ssid_t other = (p.object == end) ? p.subject : ((p.subject == end) ? p.object : end);
+                if (p.predicate < 0 || other == end || !bound.count(other))
+                    continue;
+
+                patterns.erase(patterns.begin() + j);
+                patterns.insert(patterns.begin() + next, p);
+                next++;
+            }
+        }
+    }
+
 public:
     Planner() { }
 
@@ -539,6 +566,8 @@ public:
             pattern.pred_type = 0;
             patterns.push_back(pattern);
         }
+        hoist_cycle_closers(patterns);
+
         //add_attr_pattern to the end of patterns
         for (int i = 0 ; i < attr_pred_chains.size(); i ++) {
             SPARQLQuery::Pattern pattern(
@@ -61,6 +61,8 @@ private:
 
     vector<Message> pending_msgs; // pending msgs to send
 
+    boost::unordered_map<int, SPARQLQuery> streams; // the streamed replies being assembled
+
     // Collect candidate constants of all template types in given template query.
     // Result is in ptypes_grp of given template query.
     void fill_template(SPARQLQuery_Template &sqt) {
@@ -175,24 +177,61 @@ public:
         send(bundle, start_sid);
     }
 
+    // Assemble a chunk of a streamed reply (see Engine::stream_reply) to @r.
+    // Return false if more chunks of the reply are expected.
+    bool assemble_reply(SPARQLQuery &r) {
+        if (r.nchunks == 1)
+            return true; // not streamed
+
+        if (r.chunk_id == 0) {
+            streams[r.pid] = std::move(r);
+            return false;
+        }
+
+        // the chunks arrive in order
+        ASSERT(streams.find(r.pid) != streams.end());
+        SPARQLQuery &whole = streams[r.pid];
+        ASSERT(r.chunk_id == whole.chunk_id + 1);
+        whole.chunk_id = r.chunk_id;
+        whole.result.row_num += r.result.row_num;
+        whole.result.result_table.insert(whole.result.result_table.end(),
+                                         r.result.result_table.begin(),
+                                         r.result.result_table.end());
+        whole.result.attr_res_table.insert(whole.result.attr_res_table.end(),
+                                           r.result.attr_res_table.begin(),
+                                           r.result.attr_res_table.end());
+        if (r.chunk_id < r.nchunks - 1)
+            return false;
+
+        r = std::move(whole);
+        r.chunk_id = 0;
+        r.nchunks = 1;
+        streams.erase(r.pid);
+        return true;
+    }
+
     // Recv reply from engines.
     SPARQLQuery recv_reply(void) {
-        Bundle bundle = adaptor->recv();
-        ASSERT(bundle.type == SPARQL_QUERY);
-        SPARQLQuery r = bundle.get_sparql_query();
-        return r;
+        while (true) {
+            Bundle bundle = adaptor->recv();
+            ASSERT(bundle.type == SPARQL_QUERY);
+            SPARQLQuery r = bundle.get_sparql_query();
+            if (assemble_reply(r))
+                return r;
+        }
     }
 
     // Try recv reply from engines.
     bool tryrecv_reply(SPARQLQuery &r) {
         Bundle bundle;
-        bool success = adaptor->tryrecv(bundle);
-        if (success) {
+        while (adaptor->tryrecv(bundle)) {
             ASSERT(bundle.type == SPARQL_QUERY);
             r = bundle.get_sparql_query();
+            if (assemble_reply(r))
+                return true;
         }
 
-        return success;
+        return false;
     }
 
     // Run a single query for @cnt times. Command is "-f"
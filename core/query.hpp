@@ -31,6 +31,8 @@
 #include <boost/serialization/split_free.hpp>
 #include <set>
 #include <vector>
+#include <cmath>
+#include <limits>
 
 #include "type.hpp"
 
@@ -233,6 +235,29 @@ public:
             : id(_id), descending(_descending) { }
     };
 
+    class Aggregate {
+    private:
+        friend class boost::serialization::access;
+        template <typename Archive>
+        void serialize(Archive &ar, const unsigned int version) {
+            ar & type;
+            ar & id;
+            ar & alias;
+        }
+
+    public:
+        enum Type { COUNT, SUM, MIN, MAX, AVG };
+
+        Type type;
+        ssid_t id;      /// variable id (0: all rows, i.e., COUNT(*))
+        ssid_t alias;   /// variable id of the result
+
+        Aggregate() { }
+
+        Aggregate(Type _type, ssid_t _id, ssid_t _alias)
+            : type(_type), id(_id), alias(_alias) { }
+    };
+
     class Result {
     private:
         friend class boost::serialization::access;
@@ -250,7 +275,10 @@ public:
 
                 for (int c = 0; c < this->get_attr_col_num(); c++) {
                     attr_t tmp = this->get_attr_row_col(i, c);
-                    stream << tmp << "\t";
+                    if (is_unbound_attr(tmp))
+                        stream << "\t";
+                    else
+                        stream << tmp << "\t";
                 }
 
                 stream << endl;
@@ -263,6 +291,7 @@ public:
         int attr_col_num = 0; // FIXME: why not no attr_row_num
 
         bool blind = false;
+        bool aggregated = false; // the rows are partial aggregates (see Engine::aggregate)
         int nvars = 0; // the number of variables
         vector<int> v2c_map; // from variable ID (vid) to column ID, index: vid, value: col
         vector<ssid_t> required_vars; // variables selected to return
@@ -364,13 +393,22 @@ public:
         }
 
         void append_row_to(int r, vector<sid_t> &update) {
-            for (int c = 0; c < col_num; c++)
-                update.push_back(get_row_col(r, c));
+            update.insert(update.end(),
+                          result_table.begin() + col_num * r,
+                          result_table.begin() + col_num * (r + 1));
         }
 
         // result table for others (e.g., integer, float, and double)
         int set_attr_col_num(int n) { attr_col_num = n; }
 
+        // the unbound value of attribute columns (e.g., MIN of no values), i.e., a NaN double
+        static attr_t unbound_attr() { return std::numeric_limits<double>::quiet_NaN(); }
+
+        static bool is_unbound_attr(const attr_t &v) {
+            const double *d = boost::get<double>(&v);
+            return (d != NULL && std::isnan(*d));
+        }
+
         int get_attr_col_num() { return  attr_col_num; }
 
         attr_t get_attr_row_col(int r, int c) {
@@ -378,8 +416,60 @@ public:
         }
 
         void append_attr_row_to(int r, vector<attr_t> &updated_result_table) {
-            for (int c = 0; c < attr_col_num; c++)
-                updated_result_table.push_back(get_attr_row_col(r, c));
+            updated_result_table.insert(updated_result_table.end(),
+                                        attr_res_table.begin() + attr_col_num * r,
+                                        attr_res_table.begin() + attr_col_num * (r + 1));
+        }
+
+        /// Selection vectors
+        /// Instead of copying rows for each operator (e.g., DISTINCT, ORDER BY, OFFSET and LIMIT),
+        /// the operators only shrink or reorder a vector of row IDs (selection vector), and
+        /// the selected rows are materialized once at last.
+
+        // Keep the rows whose flags are set in place (e.g., FILTER).
+        void select_rows(const vector<bool> &keep) {
+            int nrows = get_row_num();
+            ASSERT(keep.size() == nrows);
+
+            int n = 0;
+            for (int r = 0; r < nrows; r++) {
+                if (!keep[r]) continue;
+                if (n != r) {
+                    std::copy(result_table.begin() + col_num * r,
+                              result_table.begin() + col_num * (r + 1),
+                              result_table.begin() + col_num * n);
+                    if (attr_col_num > 0)
+                        std::copy(attr_res_table.begin() + attr_col_num * r,
+                                  attr_res_table.begin() + attr_col_num * (r + 1),
+                                  attr_res_table.begin() + attr_col_num * n);
+                }
+                n++;
+            }
+            result_table.resize(col_num * n);
+            if (attr_col_num > 0)
+                attr_res_table.resize(attr_col_num * n);
+            row_num = get_row_num();
+        }
+
+        // Materialize the selected rows (in order) w/ given columns (and attribute columns).
+        void materialize(const vector<int> &rows, const vector<int> &cols, const vector<int> &attr_cols) {
+            vector<sid_t> new_table;
+            new_table.reserve(rows.size() * cols.size());
+            for (auto r : rows)
+                for (auto c : cols)
+                    new_table.push_back(get_row_col(r, c));
+
+            vector<attr_t> new_attr_table;
+            new_attr_table.reserve(rows.size() * attr_cols.size());
+            for (auto r : rows)
+                for (auto c : attr_cols)
+                    new_attr_table.push_back(get_attr_row_col(r, c));
+
+            result_table.swap(new_table);
+            attr_res_table.swap(new_attr_table);
+            col_num = cols.size();
+            attr_col_num = attr_cols.size();
+            row_num = get_row_num();
         }
 
         // insert a blank col to result table without updating col_num and v2c_map
@@ -440,6 +530,7 @@ public:
         void append_result(SPARQLQuery::Result &result) {
             this->col_num = result.col_num;
             this->blind = result.blind;
+            this->aggregated = result.aggregated;
             this->row_num += result.row_num;
             this->attr_col_num = result.attr_col_num;
             this->v2c_map = result.v2c_map;
@@ -510,6 +601,14 @@ public:
     unsigned offset = 0;
     bool distinct = false;
 
+    // GROUP BY and aggregates
+    vector<ssid_t> group_vars;
+    vector<Aggregate> aggregates;
+
+    // the reply is streamed in chunks of rows (see Engine::stream_reply)
+    int chunk_id = 0;
+    int nchunks = 1;
+
 
     // ID-format triple patterns (Subject, Predicat, Direction, Object)
     PatternGroup pattern_group;
@@ -539,6 +638,8 @@ public:
     // shrink the query to reduce communication cost (before sending)
     void shrink_query() {
         orders.clear();
+        group_vars.clear();
+        aggregates.clear();
         // the first pattern indicating if this query is starting from index. It can't be removed.
         if (pattern_group.patterns.size() > 0)
             pattern_group.patterns.erase(pattern_group.patterns.begin() + 1,
@@ -560,6 +661,19 @@ public:
 
     bool has_filter() { return pattern_group.filters.size() > 0; }
 
+    bool has_aggregate() { return group_vars.size() > 0 || aggregates.size() > 0; }
+
+    // the rows after all patterns are final (w/o UNION, OPTIONAL and FILTER)
+    bool final_rows() { return !has_union() && !has_optional() && !has_filter(); }
+
+    // Return the #rows enough to answer the query (i.e., OFFSET + LIMIT), or -1 if all rows are needed.
+    // NOTE: any final rows are OK w/o ORDER BY, DISTINCT and aggregates.
+    int64_t enough_rows() {
+        if (limit < 0 || orders.size() > 0 || distinct || has_aggregate() || !final_rows())
+            return -1;
+        return (int64_t)offset + limit;
+    }
+
     bool done(SQState state) {
         switch (state) {
         case SQ_PATTERN:
@@ -901,6 +1015,7 @@ void save(Archive &ar, const SPARQLQuery::Result &t, unsigned int version) {
     ar << t.row_num;
     ar << t.attr_col_num;
     ar << t.blind;
+    ar << t.aggregated;
     ar << t.nvars;
     ar << t.v2c_map;
     ar << t.optional_matched_rows;
@@ -922,6 +1037,7 @@ void load(Archive & ar, SPARQLQuery::Result &t, unsigned int version) {
     ar >> t.row_num;
     ar >> t.attr_col_num;
     ar >> t.blind;
+    ar >> t.aggregated;
     ar >> t.nvars;
     ar >> t.v2c_map;
     ar >> t.optional_matched_rows;
@@ -951,6 +1067,8 @@ void save(Archive & ar, const SPARQLQuery &t, unsigned int version) {
     ar << t.mt_factor;
     ar << t.priority;
     ar << t.state;
+    ar << t.chunk_id;
+    ar << t.nchunks;
     ar << t.pattern_group;
     if (t.orders.size() > 0) {
         ar << occupied;
@@ -958,6 +1076,13 @@ void save(Archive & ar, const SPARQLQuery &t, unsigned int version) {
     } else {
         ar << empty;
     }
+    if (t.group_vars.size() > 0 || t.aggregates.size() > 0) {
+        ar << occupied;
+        ar << t.group_vars;
+        ar << t.aggregates;
+    } else {
+        ar << empty;
+    }
     ar << t.result;
 }
 
@@ -980,9 +1105,16 @@ void load(Archive & ar, SPARQLQuery &t, unsigned int version) {
     ar >> t.mt_factor;
     ar >> t.priority;
     ar >> t.state;
+    ar >> t.chunk_id;
+    ar >> t.nchunks;
     ar >> t.pattern_group;
     ar >> temp;
     if (temp == occupied) ar >> t.orders;
+    ar >> temp;
+    if (temp == occupied) {
+        ar >> t.group_vars;
+        ar >> t.aggregates;
+    }
     ar >> t.result;
 }
 
@@ -1001,6 +1133,7 @@ BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Pattern, boost::serialization::object_se
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::PatternGroup, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Filter, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Order, boost::serialization::object_serializable);
+BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Aggregate, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery::Result, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(SPARQLQuery, boost::serialization::object_serializable);
 BOOST_CLASS_IMPLEMENTATION(GStoreCheck, boost::serialization::object_serializable);
@@ -1014,6 +1147,7 @@ BOOST_CLASS_TRACKING(SPARQLQuery::Pattern, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::Filter, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::PatternGroup, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::Order, boost::serialization::track_never);
+BOOST_CLASS_TRACKING(SPARQLQuery::Aggregate, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery::Result, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(SPARQLQuery, boost::serialization::track_never);
 BOOST_CLASS_TRACKING(GStoreCheck, boost::serialization::track_never);
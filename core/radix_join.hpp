@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2016 Shanghai Jiao Tong University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://ipads.se.sjtu.edu.cn/projects/wukong
+ *
+ */
+
+#pragma once
+
+#include <stdint.h> // uint64_t
+#include <string.h> // memcmp
+#include <vector>
+
+#include "type.hpp"
+#include "assertion.hpp"
+#include "mymath.hpp"
+
+using namespace std;
+
+/**
+ * A radix-partitioned hash join over the rows of result tables (row-major), keyed by
+ * any number of columns.
+ *
+ * Both the build and the probe rows are first clustered into 2^nbits partitions by the
+ * low bits of the hash of their keys, so that each partition of the build side (keys and
+ * an open-addressing table) fits in the cache while being probed.
+ *
+ * e.g., semi-join: build(sub_table, 3, {0, 2, 1}); semi_join(table, 5, {1, 3, 4}, matched);
+ *       distinct: for (p < cluster(table, 5, {1, 3})) distinct(p, first);
+ */
+class Radix_Join {
+private:
+    static const uint64_t PART_ROWS = 1 << 14; // #rows per partition (fits in the L2 cache)
+    static const int MAX_BITS = 12;            // at most 4096 partitions
+    static const uint32_t EMPTY = UINT32_MAX;
+
+    struct slot_t {
+        uint32_t tag;  // the high bits of hash
+        uint32_t idx;  // the index of build keys
+    };
+
+    // the rows clustered by partition
+    struct parts_t {
+        vector<sid_t> keys;     // the keys of rows
+        vector<uint64_t> rows;  // the (original) row of every key
+        vector<uint64_t> hashes;
+        vector<uint64_t> start; // partition p has the rows [start[p], start[p + 1])
+    };
+
+    int nkeys = 0; // #columns of keys
+    int nbits = 0; // #radix bits
+
+    parts_t build_parts;
+    vector<slot_t> slots;         // the hash tables of all partitions
+    vector<uint64_t> slots_start; // partition p has the slots [slots_start[p], slots_start[p + 1])
+
+    static inline uint64_t hash_of(const sid_t *key, int n) {
+        uint64_t h = n;
+        for (int c = 0; c < n; c++)
+            h = mymath::hash_u64(h ^ key[c]);
+        return h;
+    }
+
+    // Cluster the rows of @table (@ncols columns) by the partition of their keys (@cols)
+    void partition(const vector<sid_t> &table, int ncols, const vector<int> &cols, parts_t &parts) {
+        ASSERT(cols.size() == nkeys);
+        uint64_t nrows = table.size() / ncols;
+        uint64_t nparts = 1ull << nbits;
+
+        // pass 1: histogram
+        vector<uint64_t> hashes(nrows);
+        vector<sid_t> key(nkeys);
+        parts.start.assign(nparts + 1, 0);
+        for (uint64_t r = 0; r < nrows; r++) {
+            for (int c = 0; c < nkeys; c++)
+                key[c] = table[r * ncols + cols[c]];
+            hashes[r] = hash_of(key.data(), nkeys);
+            parts.start[(hashes[r] & (nparts - 1)) + 1]++;
+        }
+        for (uint64_t p = 0; p < nparts; p++)
+            parts.start[p + 1] += parts.start[p];
+
+        // pass 2: scatter
+        vector<uint64_t> pos(parts.start.begin(), parts.start.end() - 1);
+        parts.keys.resize(nrows * nkeys);
+        parts.rows.resize(nrows);
+        parts.hashes.resize(nrows);
+        for (uint64_t r = 0; r < nrows; r++) {
+            uint64_t i = pos[hashes[r] & (nparts - 1)]++;
+            for (int c = 0; c < nkeys; c++)
+                parts.keys[i * nkeys + c] = table[r * ncols + cols[c]];
+            parts.rows[i] = r;
+            parts.hashes[i] = hashes[r];
+        }
+    }
+
+    // Call @match(probe_row, build_row) for the matched rows of @table, and only for
+    // the first matched build row if @first_only.
+    template <typename F>
+    void probe(const vector<sid_t> &table, int ncols, const vector<int> &cols,
+               bool first_only, F match) {
+        parts_t parts;
+        partition(table, ncols, cols, parts);
+
+        for (uint64_t p = 0; p < (1ull << nbits); p++) {
+            uint64_t base = slots_start[p];
+            uint64_t mask = slots_start[p + 1] - base - 1;
+            if (build_parts.start[p] == build_parts.start[p + 1])
+                continue; // empty partition
+
+            for (uint64_t i = parts.start[p]; i < parts.start[p + 1]; i++) {
+                uint64_t h = parts.hashes[i];
+                uint32_t tag = h >> 32;
+                const sid_t *key = &parts.keys[i * nkeys];
+                for (uint64_t s = (h >> nbits) & mask; slots[base + s].idx != EMPTY; s = (s + 1) & mask) {
+                    const slot_t &slot = slots[base + s];
+                    if (slot.tag == tag
+                            && memcmp(&build_parts.keys[(uint64_t)slot.idx * nkeys], key,
+                                      nkeys * sizeof(sid_t)) == 0) {
+                        match(parts.rows[i], build_parts.rows[slot.idx]);
+                        if (first_only)
+                            break;
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    // Build the hash tables from the rows of @table (@ncols columns) keyed by @cols.
+    void build(const vector<sid_t> &table, int ncols, const vector<int> &cols) {
+        nkeys = cols.size();
+        uint64_t nrows = table.size() / ncols;
+        ASSERT(nkeys > 0 && nrows < EMPTY);
+
+        nbits = 0;
+        while (nbits < MAX_BITS && (nrows >> nbits) > PART_ROWS)
+            nbits++;
+
+        partition(table, ncols, cols, build_parts);
+
+        // an open-addressing (linear probing) table per partition, at most half full
+        uint64_t nparts = 1ull << nbits;
+        slots_start.assign(nparts + 1, 0);
+        for (uint64_t p = 0; p < nparts; p++) {
+            uint64_t sz = 2;
+            while (sz < (build_parts.start[p + 1] - build_parts.start[p]) * 2)
+                sz <<= 1;
+            slots_start[p + 1] = slots_start[p] + sz;
+        }
+
+        slot_t empty = { 0, EMPTY };
+        slots.assign(slots_start[nparts], empty);
+        for (uint64_t p = 0; p < nparts; p++) {
+            uint64_t base = slots_start[p];
+            uint64_t mask = slots_start[p + 1] - base - 1;
+            for (uint64_t i = build_parts.start[p]; i < build_parts.start[p + 1]; i++) {
+                uint64_t h = build_parts.hashes[i];
+                uint64_t s = (h >> nbits) & mask;
+                while (slots[base + s].idx != EMPTY)
+                    s = (s + 1) & mask;
+                slots[base + s].tag = h >> 32;
+                slots[base + s].idx = i;
+            }
+        }
+    }
+
+    // Cluster the rows of @table (@ncols columns) by the partition of their keys (@cols)
+    // for distinct(), and return the number of partitions.
+    uint64_t cluster(const vector<sid_t> &table, int ncols, const vector<int> &cols) {
+        nkeys = cols.size();
+        uint64_t nrows = table.size() / ncols;
+        ASSERT(nkeys > 0);
+
+        nbits = 0;
+        while (nbits < MAX_BITS && (nrows >> nbits) > PART_ROWS)
+            nbits++;
+
+        partition(table, ncols, cols, build_parts);
+        return 1ull << nbits;
+    }
+
+    // Set @first[r] for the first row r of every distinct keys within partition @p.
+    // The rows of a partition keep the original order, and only a hash table of the
+    // partition is used, so different partitions can be deduplicated in parallel.
+    // NOTE: @first must not be a vector<bool>, whose bits are not thread-safe
+    void distinct(uint64_t p, vector<char> &first) const {
+        uint64_t begin = build_parts.start[p], end = build_parts.start[p + 1];
+        uint64_t sz = 2;
+        while (sz < (end - begin) * 2)
+            sz <<= 1;
+
+        slot_t empty = { 0, EMPTY };
+        vector<slot_t> table(sz, empty);
+        for (uint64_t i = begin; i < end; i++) {
+            uint64_t h = build_parts.hashes[i];
+            uint32_t tag = h >> 32;
+            const sid_t *key = &build_parts.keys[i * nkeys];
+            uint64_t s = (h >> nbits) & (sz - 1);
+            bool dup = false;
+            for (; table[s].idx != EMPTY; s = (s + 1) & (sz - 1)) {
+                if (table[s].tag == tag
+                        && memcmp(&build_parts.keys[(uint64_t)table[s].idx * nkeys], key,
+                                  nkeys * sizeof(sid_t)) == 0) {
+                    dup = true;
+                    break;
+                }
+            }
+            if (!dup) {
+                table[s].tag = tag;
+                table[s].idx = i;
+                first[build_parts.rows[i]] = true;
+            }
+        }
+    }
+
+    // Set @matched[r] to whether the row r of @table (@ncols columns) has a build row
+    // with the same keys (@cols).
+    void semi_join(const vector<sid_t> &table, int ncols, const vector<int> &cols,
+                   vector<bool> &matched) {
+        matched.assign(table.size() / ncols, false);
+        probe(table, ncols, cols, true, [&matched](uint64_t r, uint64_t b) {
+            matched[r] = true;
+        });
+    }
+
+    // Call @emit(r, b) for every pair of the row r of @table (@ncols columns) and
+    // the build row b with the same keys (@cols), clustered by partition.
+    template <typename F>
+    void join(const vector<sid_t> &table, int ncols, const vector<int> &cols, F emit) {
+        probe(table, ncols, cols, false, emit);
+    }
+};
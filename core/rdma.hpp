@@ -26,11 +26,24 @@
 
 #include <iostream>     // std::cout
 #include <fstream>      // std::ifstream
+#include <string.h>     // memcpy
+#include <vector>
 using namespace std;
 
 #include "timer.hpp"
 #include "assertion.hpp"
 
+// A request of RDMA Read (see RdmaReadBatch)
+struct rdma_read_req_t {
+    int nid;        // the remote node
+    char *local;    // the local buffer
+    uint64_t sz;
+    uint64_t off;   // the offset in the remote memory
+
+    rdma_read_req_t(int nid, char *local, uint64_t sz, uint64_t off)
+        : nid(nid), local(local), sz(sz), off(off) { }
+};
+
 #ifdef HAS_RDMA
 
 #include "rdmaio.hpp"
@@ -39,11 +52,23 @@ using namespace rdmaio;
 class RDMA {
     class RDMA_Device {
         static const uint64_t RDMA_CTRL_PORT = 19344;
+        static const int MAX_OUTSTANDING_READS = 16; // per batch (see RdmaReadBatch)
+
+        int nnodes;
+
+        void poll_reads(int tid, vector<int> &inflight) {
+            for (int i = 0; i < nnodes; i++) {
+                if (inflight[i] == 0) continue;
+                ctrl->get_rc_qp(tid, i)->poll_completions(inflight[i]);
+                inflight[i] = 0;
+            }
+        }
+
     public:
         RdmaCtrl* ctrl = NULL;
 
         RDMA_Device(int nnodes, int nthds, int nid,
-                    char *mem, uint64_t sz, string ipfn) {
+                    char *mem, uint64_t sz, string ipfn) : nnodes(nnodes) {
             // record IPs of ndoes
             vector<string> ipset;
             ifstream ipfile(ipfn);
@@ -105,6 +130,30 @@ class RDMA {
             return 0;
         }
 
+        // (sync) a batch of RDMA Reads (w/ completion)
+        // The reads are posted before polling their completions (at most MAX_OUTSTANDING_READS
+        // in flight), so that their round trips are overlapped.
+        int RdmaReadBatch(int tid, vector<rdma_read_req_t> &reqs) {
+            vector<int> inflight(nnodes, 0);
+            int total = 0;
+            for (auto const &r : reqs) {
+                Qp* qp = ctrl->get_rc_qp(tid, r.nid);
+
+                // sweep remaining completion events (due to selective RDMA writes)
+                if (!qp->first_send())
+                    qp->poll_completion();
+
+                qp->rc_post_send(IBV_WR_RDMA_READ, r.local, r.sz, r.off, IBV_SEND_SIGNALED);
+                inflight[r.nid]++;
+                if (++total == MAX_OUTSTANDING_READS) {
+                    poll_reads(tid, inflight);
+                    total = 0;
+                }
+            }
+            poll_reads(tid, inflight);
+            return 0;
+        }
+
         // (sync) RDMA Write (w/ completion)
         int RdmaWrite(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
             Qp* qp = ctrl->get_rc_qp(tid, nid);
@@ -168,6 +217,84 @@ void RDMA_init(int nnodes, int nthds, int nid,
     logstream(LOG_INFO) << "initializing RMDA done (" << t / 1000  << " ms)" << LOG_endl;
 }
 
+#elif defined(RDMA_LOOPBACK)
+
+/**
+ * A loopback RDMA device for a single server without RDMA NICs, which serves the
+ * one-sided operations by copying from/to the local (registered) memory.
+ * It is used to evaluate (and debug) the RDMA-based code paths, e.g., batched reads.
+ */
+class RDMA {
+    class RDMA_Device {
+        char *mem;
+        uint64_t mem_sz;
+
+        inline void check(int nid, uint64_t sz, uint64_t off) {
+            ASSERT(nid == 0); // only loopback
+            ASSERT(off + sz <= mem_sz);
+        }
+
+    public:
+        RDMA_Device(int nnodes, int nthds, int nid, char *mem, uint64_t sz, string ipfn)
+            : mem(mem), mem_sz(sz) {
+            if (nnodes != 1) {
+                logstream(LOG_ERROR) << "The loopback RDMA device only supports a single server." << LOG_endl;
+                ASSERT(false);
+            }
+        }
+
+        int RdmaRead(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+            check(nid, sz, off);
+            memcpy(local, mem + off, sz);
+            return 0;
+        }
+
+        int RdmaReadBatch(int tid, vector<rdma_read_req_t> &reqs) {
+            for (auto const &r : reqs)
+                RdmaRead(tid, r.nid, r.local, r.sz, r.off);
+            return 0;
+        }
+
+        int RdmaWrite(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+            check(nid, sz, off);
+            memcpy(mem + off, local, sz);
+            return 0;
+        }
+
+        int RdmaWriteNonSignal(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+            return RdmaWrite(tid, nid, local, sz, off);
+        }
+
+        int RdmaWriteSelective(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
+            return RdmaWrite(tid, nid, local, sz, off);
+        }
+    };
+
+public:
+    RDMA_Device *dev = NULL;
+
+    RDMA() { }
+
+    ~RDMA() { if (dev != NULL) delete dev; }
+
+    void init_dev(int nnodes, int nthds, int nid, char *mem, uint64_t sz, string ipfn) {
+        dev = new RDMA_Device(nnodes, nthds, nid, mem, sz, ipfn);
+    }
+
+    inline static bool has_rdma() { return true; }
+
+    static RDMA &get_rdma() {
+        static RDMA rdma;
+        return rdma;
+    }
+};
+
+void RDMA_init(int nnodes, int nthds, int nid, char *mem, uint64_t sz, string ipfn) {
+    RDMA &rdma = RDMA::get_rdma();
+    rdma.init_dev(nnodes, nthds, nid, mem, sz, ipfn);
+    logstream(LOG_INFO) << "initializing loopback RDMA device done" << LOG_endl;
+}
+
 #else
 
 class RDMA {
@@ -184,6 +311,12 @@ class RDMA {
             return 0;
         }
 
+        int RdmaReadBatch(int tid, vector<rdma_read_req_t> &reqs) {
+            logstream(LOG_INFO) << "This system is compiled without RDMA support." << LOG_endl;
+            ASSERT(false);
+            return 0;
+        }
+
         int RdmaWrite(int tid, int nid, char *local, uint64_t sz, uint64_t off) {
             logstream(LOG_INFO) << "This system is compiled without RDMA support." << LOG_endl;
             ASSERT(false);
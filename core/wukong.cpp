@@ -42,10 +42,7 @@
 void *engine_thread(void *arg)
 {
     Engine *engine = (Engine *)arg;
-    if (enable_binding && core_bindings.count(engine->tid) != 0)
-        bind_to_core(core_bindings[engine->tid]);
-    else
-        bind_to_core(default_bindings[engine->tid % num_cores]);
+    bind_to_core(core_of_thread(engine->tid));
 
     engine->run();
 }
@@ -53,10 +50,7 @@ void *engine_thread(void *arg)
 void *proxy_thread(void *arg)
 {
     Proxy *proxy = (Proxy *)arg;
-    if (enable_binding && core_bindings.count(proxy->tid) != 0)
-        bind_to_core(core_bindings[proxy->tid]);
-    else
-        bind_to_core(default_bindings[proxy->tid % num_cores]);
+    bind_to_core(core_of_thread(proxy->tid));
 
     // run the builtin console
     run_console(proxy);
@@ -133,7 +127,9 @@ main(int argc, char *argv[])
 	printf("data statistic finished\n");
     if (global_enable_planner) {
         if (global_generate_statistics) {
-            dgraph.gstore.generate_statistic(stat);
+            // the local statistics may be restored from the snapshot
+            if (!dgraph.load_snapshot_stat(stat))
+                dgraph.gstore.generate_statistic(stat);
             stat.gather_stat();
         } else {
             // use the dataset name by default
@@ -145,6 +141,9 @@ main(int argc, char *argv[])
         }
     }
 
+    // store the snapshot of DGraph (w/ statistics) for fast restart
+    dgraph.store_snapshot((global_enable_planner && global_generate_statistics) ? &stat : NULL);
+
     // init control communicaiton
     con_adaptor = new TCP_Adaptor(sid, host_fname, global_num_proxies, global_ctrl_port_base);
 	printf("tcp finished\n");